@@ -11,27 +11,34 @@ class MaskSet {
     U64 PAWN_ATTACKS[2][64];
     U64 KNIGHT_ATTACKS[64];
     U64 KING_ATTACKS[64];
-    U64 RAYS[64][8];
+    U64 RAYS[8][64];
+    // the squares strictly between two squares on a line, and the whole line through them
+    U64 BETWEEN[64][64];
+    U64 LINE[64][64];
 
-    MaskSet() {
+    // constexpr, the whole set is built by the compiler into MASKS below
+    constexpr MaskSet()
+        : PAWN_MOVES{}, PAWN_ATTACKS{}, KNIGHT_ATTACKS{}, KING_ATTACKS{}, RAYS{}, BETWEEN{}, LINE{} {
         for (int i = 0; i < 64; i++) {
+            PAWN_MOVES[WHITE][i] = 0;
+            PAWN_MOVES[BLACK][i] = 0;
             // if a pawn is on the backrank, it can't move.
             if ((1ULL << i) & BB_BACKRANKS) {
                 PAWN_MOVES[WHITE][i] = 0;
                 PAWN_MOVES[BLACK][i] = 0;
             } else if ((1ULL << i) & BB_RANK_2) {
                 // on rank 2, the white pawns can double-move
-                PAWN_MOVES[WHITE][i] |= 1LL << i + 8;
-                PAWN_MOVES[WHITE][i] |= 1LL << i + 16;
-                PAWN_MOVES[BLACK][i] |= 1LL << i - 8;
+                PAWN_MOVES[WHITE][i] |= 1ULL << (i + 8);
+                PAWN_MOVES[WHITE][i] |= 1ULL << (i + 16);
+                PAWN_MOVES[BLACK][i] |= 1ULL << (i - 8);
             } else if ((1ULL << i) & BB_RANK_7) {
                 // on rank 7, the black pawns can double-move
-                PAWN_MOVES[WHITE][i] |= 1LL << i + 8;
-                PAWN_MOVES[BLACK][i] |= 1LL << i - 8;
-                PAWN_MOVES[BLACK][i] |= 1LL << i - 16;
+                PAWN_MOVES[WHITE][i] |= 1ULL << (i + 8);
+                PAWN_MOVES[BLACK][i] |= 1ULL << (i - 8);
+                PAWN_MOVES[BLACK][i] |= 1ULL << (i - 16);
             } else {
-                PAWN_MOVES[WHITE][i] |= 1LL << i + 8;
-                PAWN_MOVES[BLACK][i] |= 1LL << i - 8;
+                PAWN_MOVES[WHITE][i] |= 1ULL << (i + 8);
+                PAWN_MOVES[BLACK][i] |= 1ULL << (i - 8);
             }
         }
 
@@ -42,7 +49,21 @@ class MaskSet {
 
         for (int i = 0; i < 64; i++) {
             for (int dir = 0; dir < 8; dir++) {
-                RAYS[i][dir] = RBP::ray_bitmask_pregenerator(i, dir);
+                RAYS[dir][i] = RBP::ray_bitmask_pregenerator(i, dir);
+            }
+        }
+
+        // directions are laid out so that dir and (dir + 4) % 8 point opposite ways
+        for (int a = 0; a < 64; a++) {
+            for (int dir = 0; dir < 8; dir++) {
+                int opposite = (dir + 4) % 8;
+                U64 ray = RAYS[dir][a];
+                while (ray) {
+                    int b = __builtin_ctzll(ray);
+                    BETWEEN[a][b] = RAYS[dir][a] & RAYS[opposite][b];
+                    LINE[a][b] = RAYS[dir][a] | RAYS[opposite][a] | (1ULL << a);
+                    ray &= ray - 1;
+                }
             }
         }
 
@@ -50,3 +71,6 @@ class MaskSet {
         for (int i = 0; i < 64; i++) KING_ATTACKS[i] = BB_KING_ATTACKS[i];
     }
 };
+
+// the one set of tables every State and generator reads, generated at compile time
+constexpr MaskSet MASKS = MaskSet();
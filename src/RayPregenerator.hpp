@@ -1,59 +1,63 @@
+#pragma once
+
 #include "names.hpp"
-#include "vorpal_helpers.hpp"
 
 using U64 = unsigned long long;
 
 namespace RBP {
-auto row(int index) -> int {
+constexpr auto row(int index) -> int {
     return index / 8;
 }
 
-auto col(int index) -> int {
+constexpr auto col(int index) -> int {
     return index % 8;
 }
 
-auto index(int row, int col) -> int {
+constexpr auto index(int row, int col) -> int {
     if (row > 7 || col > 7 || row < 0 || col < 0) {
         return 64;
     }
     return row * 8 + col;
 }
 
-auto set_bit(int index, U64 &bitboard) -> U64 {
+constexpr auto set_bit(int index, U64 &bitboard) -> U64 {
     bitboard |= 1ULL << index;
+    return bitboard;
 }
 
-auto ray_bitmask_pregenerator(int square, int dir) -> U64 {
+// rows count up the board from rank 1, so NORTH rays run towards rank 8 (increasing indices).
+// constexpr, so that MaskSet can build every ray at compile time.
+constexpr auto ray_bitmask_pregenerator(int square, int dir) -> U64 {
     int r = row(square);
     int c = col(square);
     U64 outputMask = 0;
     switch (dir) {
-        case SOUTH_EAST:
+        case NORTH_EAST:
             for (int i = 1; index(r + i, c + i) >= 0 && index(r + i, c + i) <= 63; i++) {
                 set_bit(index(r + i, c + i), outputMask);
             }
             break;
-        case NORTH_WEST:
+        case SOUTH_WEST:
             for (int i = 1; index(r - i, c - i) >= 0 && index(r - i, c - i) <= 63; i++) {
                 set_bit(index(r - i, c - i), outputMask);
             }
             break;
-        case SOUTH_WEST:
+        case NORTH_WEST:
             for (int i = 1; index(r + i, c - i) >= 0 && index(r + i, c - i) <= 63; i++) {
                 set_bit(index(r + i, c - i), outputMask);
             }
             break;
-        case NORTH_EAST:
+        case SOUTH_EAST:
             for (int i = 1; index(r - i, c + i) >= 0 && index(r - i, c + i) <= 63; i++) {
                 set_bit(index(r - i, c + i), outputMask);
             }
             break;
-        case NORTH:
+        case SOUTH:
             for (int i = 1; index(r - i, c) >= 0 && index(r - i, c) <= 63; i++) {
                 set_bit(index(r - i, c), outputMask);
             }
             break;
-        case SOUTH:
+        case NORTH:
             for (int i = 1; index(r + i, c) >= 0 && index(r + i, c) <= 63; i++) {
                 set_bit(index(r + i, c), outputMask);
             }
@@ -69,7 +73,7 @@ auto ray_bitmask_pregenerator(int square, int dir) -> U64 {
             }
             break;
         default:
-            std::cout << "error in ray_bitmask_generator";
+            // not a direction, no ray
             break;
     }
 
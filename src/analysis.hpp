@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cctype>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "engine.hpp"
+#include "search.hpp"
+#include "state.hpp"
+#include "tablebase.hpp"
+#include "vorpal_helpers.hpp"
+
+// batch analysis of a file of positions, for working through far more positions than it
+// would be worth starting a process for each.
+//
+// every worker thread owns a single-threaded engine with a hash table of its own and pulls
+// the next line from the input as soon as it's done with the last, so a slow position only
+// holds up its own worker. results are written as they finish, so they come out of order;
+// each line starts with the number of the input line it answers. a line that isn't a legal
+// position gets an error line of its own rather than stopping the run.
+
+namespace Analysis {
+struct Limits {
+    int depth = MAX_PLY - 1;
+    U64 nodes = 0;       // 0 for no limit
+    size_t hash_mb = 16;  // per worker
+    int tb_limit = Tablebase::MAX_MEN;
+};
+
+// the position part of an EPD or FEN line: the four board fields, then the two clocks if
+// they're there. whatever follows (EPD operations such as bm or id) is left out.
+auto position_fields(const std::string& line) -> std::string {
+    std::istringstream in(line);
+    std::string field, fen;
+    for (int i = 0; i < 6 && in >> field; i++) {
+        bool number = !field.empty() && std::isdigit((unsigned char)field[0]);
+        if (i >= 4 && !number) break;
+        fen += (fen.empty() ? "" : " ") + field;
+    }
+    return fen;
+}
+
+// analyses every line of input with workers threads and returns how many positions it did
+auto run(std::istream& input, std::ostream& output, int workers, const Limits& limits) -> U64 {
+    std::mutex input_mutex, output_mutex;
+    U64 next_line = 0;
+    std::atomic<U64> done{0};
+
+    auto work = [&] {
+        Vorpal engine;
+        engine.verbose = false;
+        engine.set_contempt(0);  // an analysis score is the true value, not what a player would accept
+        engine.set_time_limit(0);
+        engine.set_node_limit(limits.nodes);
+        engine.set_hash_size(limits.hash_mb);
+        engine.set_tb_limit(limits.tb_limit);
+        State state;
+        std::string line;
+        while (true) {
+            U64 number;
+            {
+                std::lock_guard<std::mutex> lock(input_mutex);
+                if (!std::getline(input, line)) return;
+                number = ++next_line;
+            }
+            std::string fen = position_fields(line);
+            if (fen.empty() || fen[0] == '#') continue;
+
+            std::ostringstream report;
+            if (state.load_fen(fen)) {
+                SearchResult result = engine.search(state, limits.depth);
+                std::string best = result.best_move.is_null() ? "0000" : move_notation(result.best_move);
+                report << number << " " << state.fen() << " bestmove " << best << " score "
+                       << score_notation(result.score) << " depth " << result.depth << " nodes " << result.nodes << "\n";
+                done++;
+            } else {
+                report << number << " error invalid position " << fen << "\n";
+            }
+            {
+                std::lock_guard<std::mutex> lock(output_mutex);
+                output << report.str() << std::flush;
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 1; i < workers; i++) pool.emplace_back(work);
+    work();
+    for (std::thread& thread : pool) thread.join();
+    return done.load();
+}
+};  // namespace Analysis
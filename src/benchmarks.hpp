@@ -0,0 +1,274 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "MaskSet.hpp"
+#include "engine.hpp"
+#include "eval.hpp"
+#include "magic.hpp"
+#include "movegen.hpp"
+#include "names.hpp"
+#include "nnue.hpp"
+#include "profile.hpp"
+#include "state.hpp"
+
+using U64 = unsigned long long;
+
+namespace Bench {
+// small xorshift generator so that every run benchmarks the same positions
+class Rng {
+    U64 state;
+
+   public:
+    Rng(U64 seed) : state(seed) {}
+
+    auto next() -> U64 {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 2685821657736338717ULL;
+    }
+};
+
+struct SliderQuery {
+    Square square;
+    U64 blockers;
+};
+
+// times one slider backend over the whole query set, folding the results into a checksum
+// so that the compiler can't throw the lookups away.
+template <typename F>
+auto time_sliders(const std::vector<SliderQuery>& queries, int rounds, F attacks, U64& checksum) -> double {
+    auto start = std::chrono::steady_clock::now();
+    U64 sum = 0;
+    for (int r = 0; r < rounds; r++) {
+        for (const SliderQuery& q : queries) {
+            sum += attacks(q.square, q.blockers);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    checksum = sum;
+    return std::chrono::duration<double>(end - start).count();
+}
+
+// compares the ray-walking slider functions against the magic bitboard lookups
+// (and the PEXT lookups, when the build has them) on random occupancies with
+// roughly the density of a middlegame board.
+void slider_attacks(int queries = 1 << 16, int rounds = 64) {
+    Rng rng(0x5EED5EED5EED5EEDULL);
+    std::vector<SliderQuery> set(queries);
+    for (SliderQuery& q : set) {
+        q.square = (Square)(rng.next() & 63);
+        q.blockers = rng.next() & rng.next();
+    }
+
+    // check the two implementations agree before timing anything
+    for (const SliderQuery& q : set) {
+        if (get_bishop_moves_c(q.square, q.blockers) != get_bishop_moves_m(q.square, q.blockers) ||
+            get_rook_moves_c(q.square, q.blockers) != get_rook_moves_m(q.square, q.blockers)
+#if defined(VORPAL_SLIDERS_PEXT)
+            || get_queen_moves_m(q.square, q.blockers) != get_queen_moves_p(q.square, q.blockers)
+#endif
+        ) {
+            std::cout << "slider mismatch on square " << (int)q.square << " blockers " << q.blockers << "\n";
+            return;
+        }
+    }
+
+    auto rays = [](Square sq, U64 bb) { return get_bishop_moves_c(sq, bb) | get_rook_moves_c(sq, bb); };
+    auto magics = [](Square sq, U64 bb) { return get_queen_moves_m(sq, bb); };
+
+    U64 rays_sum, magics_sum;
+    double rays_time = time_sliders(set, rounds, rays, rays_sum);
+    double magics_time = time_sliders(set, rounds, magics, magics_sum);
+
+    double lookups = (double)queries * rounds;
+    std::cout << "engine slider backend: " << SLIDER_BACKEND << "\n";
+    std::cout << "queen attack lookups: " << (U64)lookups << "\n";
+    std::cout << "rays:   " << rays_time << "s, " << (U64)(lookups / rays_time) << " lookups/s (checksum " << rays_sum << ")\n";
+    std::cout << "magics: " << magics_time << "s, " << (U64)(lookups / magics_time) << " lookups/s (checksum " << magics_sum << ")\n";
+    std::cout << "speedup: " << rays_time / magics_time << "x\n";
+#if defined(VORPAL_SLIDERS_PEXT)
+    auto pexts = [](Square sq, U64 bb) { return get_queen_moves_p(sq, bb); };
+    U64 pexts_sum;
+    double pexts_time = time_sliders(set, rounds, pexts, pexts_sum);
+    std::cout << "pext:   " << pexts_time << "s, " << (U64)(lookups / pexts_time) << " lookups/s (checksum " << pexts_sum << ")\n";
+    std::cout << "speedup: " << rays_time / pexts_time << "x over rays, " << magics_time / pexts_time << "x over magics\n";
+#endif
+}
+
+// middlegame positions for the SMP benchmark, where the trees are wide enough to share out
+const std::vector<std::string> SMP_POSITIONS = {
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1B1PPP/R2QKB1R w KQ - 0 8",
+    "r2q1rk1/pb1nbppp/1p2pn2/2pp4/3P4/1P1BPN2/PBPN1PPP/R2Q1RK1 w - - 0 10",
+    "2rq1rk1/pp1bppbp/3p1np1/4n3/3NP3/1BN1BP2/PPPQ2PP/2KR3R w - - 0 13",
+};
+
+// lazy SMP time-to-depth: searches each position to a fixed depth from an empty
+// hash table with 1, 2, 4, ... threads, and reports the speedup over one thread.
+void smp_speedup(int depth, int max_threads = 32, size_t hash_mb = 64) {
+    Vorpal engine;
+    engine.verbose = false;
+    engine.set_time_limit(0);
+    engine.set_hash_size(hash_mb);
+
+    double base_time = 0;
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        engine.set_threads(threads);
+        U64 nodes = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const std::string& fen : SMP_POSITIONS) {
+            State state;
+            state.load_fen(fen);
+            engine.tt.clear();
+            nodes += engine.search(state, depth).nodes;
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (threads == 1) base_time = elapsed;
+        std::cout << "threads " << threads << ": depth " << depth << " in " << elapsed << "s, " << nodes << " nodes, "
+                  << (U64)(nodes / elapsed) << " nps, time-to-depth speedup " << base_time / elapsed << "x\n";
+    }
+}
+
+// the bench suite: openings, middlegames and endgames of every kind, down to a mate and a
+// stalemate at the end. changing this list changes the bench signature.
+const std::vector<std::string> BENCH_POSITIONS = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+    "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+    "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+    "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+    "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+    "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+    "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+    "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+    "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+    "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+    "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+    "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+    "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+    "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1",
+    "3b4/5kp1/1p1p1p1p/pP1PpP1P/P1P1P3/3KN3/8/8 w - - 0 1",
+    "2K5/p7/7P/5pR1/8/5k2/r7/8 w - - 0 1",
+    "8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+    "7k/3p2pp/4q3/8/4Q3/5Kp1/P6b/8 w - - 0 1",
+    "8/2p5/8/2kPKp1p/2p4P/2P5/3P4/8 w - - 0 1",
+    "8/1p3pp1/7p/5P1P/2k3P1/8/2K2P2/8 w - - 0 1",
+    "8/pp2r1k1/2p1p3/3pP2p/1P1P1P1P/P5KR/8/8 w - - 0 1",
+    "8/3p4/p1bk3p/Pp6/1Kp1PpPp/2P2P1P/2P5/5B2 b - - 0 1",
+    "5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1",
+    "6k1/6p1/P6p/r1N5/5p2/7P/1b3PP1/4R1K1 w - - 0 1",
+    "1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 1",
+    "6k1/4pp1p/3p2p1/P1pPb3/R7/1r2P1PP/3B1P2/6K1 w - - 0 1",
+    "8/3p3B/5p2/5P2/p7/PP5b/k7/6K1 w - - 0 1",
+    "5rk1/q6p/2p3bR/1pPp1rP1/1P1Pp3/P3B1Q1/1K3P2/R7 w - - 93 90",
+    "4rrk1/1p1nq3/p7/2p1P1pp/3P2bp/3Q1Bn1/PPPB4/1K2R1NR w - - 40 21",
+    "r3k2r/3nnpbp/q2pp1p1/p7/Pp1PPPP1/4BNN1/1P5P/R2Q1RK1 w kq - 0 16",
+    "3Qb1k1/1r2ppb1/pN1n2q1/Pp1Pp1Pr/4P2p/4BP2/4B1R1/1R5K b - - 11 40",
+    "4k3/3q1r2/1N2r1b1/3ppN2/2nPP3/1B1R2n1/2R1Q3/3K4 w - - 5 1",
+    "8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 1",
+    "8/8/8/5N2/8/p7/8/2NK3k w - - 0 1",
+    "8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 1",
+    "8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 1",
+    "8/2p4P/8/kr6/6R1/8/8/1K6 w - - 0 1",
+    "8/8/3P3k/8/1p6/8/1P6/1K3n2 b - - 0 1",
+    "8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124",
+    "6k1/3b3r/1p1p4/p1n2p2/1PPNpP1q/P3Q1p1/1R1RB1P1/5K2 b - - 0 1",
+    "r2r1n2/pp2bk2/2p1p2p/3q4/3PN1QP/2P3R1/P4PP1/5RK1 w - - 0 1",
+    "8/8/8/8/8/6k1/6p1/6K1 w - - 0 1",
+    "7k/7P/6K1/8/3B4/8/8/8 b - - 0 1",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+    "r2q1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP3PPP/R2QKB1R w KQ - 0 9",
+    "2r3k1/pp3pp1/4p2p/3pP3/3P1P2/2P1KQ2/P5PP/3q4 w - - 0 30",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1B1PPP/R2QKB1R w KQ - 0 8",
+};
+
+// searches every bench position to a fixed depth from an empty hash table and prints the
+// total node count, which only changes when the search does (with one thread; helper
+// threads make it vary from run to run), along with the time and nodes per second.
+void search_bench(int depth = 9, int threads = 1, size_t hash_mb = 16) {
+    Vorpal engine;
+    engine.verbose = false;
+    engine.set_time_limit(0);
+    engine.set_threads(threads);
+    engine.set_hash_size(hash_mb);
+
+    U64 nodes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const std::string& fen : BENCH_POSITIONS) {
+        State state;
+        state.load_fen(fen);
+        engine.tt.clear();
+        nodes += engine.search(state, depth).nodes;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << BENCH_POSITIONS.size() << " positions, depth " << depth << ", " << threads << " threads, " << hash_mb
+              << " MB hash\n";
+    std::cout << "nodes " << nodes << "\n";
+    std::cout << "time " << (U64)(elapsed * 1000) << " ms\n";
+    std::cout << "nps " << (U64)(nodes / elapsed) << "\n";
+    if constexpr (Profile::ENABLED) Profile::write_json(std::cerr, engine.stats);
+}
+
+// times one evaluator over every legal move of every position: push, evaluate, pop.
+// the evaluations are summed so the compiler can't throw them away.
+template <typename F>
+auto time_evals(std::vector<State>& positions, int rounds, F eval, U64& evals, long long& checksum) -> double {
+    evals = 0;
+    checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (State& state : positions) {
+            for (Move move : state.legal_moves()) {
+                state.push(move);
+                checksum += eval(state);
+                state.pop(move);
+                evals++;
+            }
+        }
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// evaluations per second: the handcrafted evaluation against the network, both with the
+// accumulator kept up by push() and pop() and rebuilt from scratch at every leaf.
+// without a network loaded it times a randomly initialised one, which costs the same.
+void nnue_evals(int rounds = 200) {
+    bool loaded = Nnue::ACTIVE;
+    if (!loaded) Nnue::randomise(0x5EED5EED5EED5EEDULL);
+
+    std::vector<State> positions(SMP_POSITIONS.size() + 1);
+    for (size_t i = 0; i < SMP_POSITIONS.size(); i++) positions[i + 1].load_fen(SMP_POSITIONS[i]);
+
+    Eval::PawnTable pawn_table;
+    U64 evals;
+    long long checksum;
+    std::cout << "network: " << (loaded ? "loaded" : "random") << ", " << Nnue::HIDDEN << " hidden, "
+              << Nnue::SIMD_NAME << " kernels\n";
+
+    auto nnue_incremental = [](const State& state) { return Nnue::evaluate(state.accumulator, state.turn); };
+    double incremental_time = time_evals(positions, rounds, nnue_incremental, evals, checksum);
+    std::cout << "nnue, incremental: " << (U64)(evals / incremental_time) << " evals/s (checksum " << checksum << ")\n";
+
+    auto nnue_refresh = [](State& state) {
+        state.refresh_accumulator();
+        return Nnue::evaluate(state.accumulator, state.turn);
+    };
+    double refresh_time = time_evals(positions, rounds, nnue_refresh, evals, checksum);
+    std::cout << "nnue, refreshed:   " << (U64)(evals / refresh_time) << " evals/s (checksum " << checksum << ")\n";
+
+    // push() and pop() skip the accumulator with the network switched off
+    Nnue::ACTIVE = false;
+    auto handcrafted = [&pawn_table](const State& state) { return evaluate(state, pawn_table); };
+    double handcrafted_time = time_evals(positions, rounds, handcrafted, evals, checksum);
+    std::cout << "handcrafted:       " << (U64)(evals / handcrafted_time) << " evals/s (checksum " << checksum << ")\n";
+    Nnue::ACTIVE = loaded;
+}
+};  // namespace Bench
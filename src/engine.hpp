@@ -1,9 +1,289 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "book.hpp"
+#include "profile.hpp"
+#include "search.hpp"
 #include "state.hpp"
+#include "tablebase.hpp"
+#include "timeman.hpp"
+#include "tt.hpp"
+#include "vorpal_helpers.hpp"
 
-class Vorpal {
-    int timeLimit = 1000;
-    int contempt = 3000;
+// what one search came up with
+struct SearchResult {
+    Move best_move = NULL_MOVE;
+    Move ponder_move = NULL_MOVE;
+    int score = 0;
+    int depth = 0;
+    U64 nodes = 0;
 };
 
+// lazy SMP: every thread runs its own iterative deepening on its own copy of the position,
+// and they only cooperate through the shared transposition table. to keep the helpers from
+// all searching the same tree in lockstep, each one skips some depths on a pattern of its own
+// (the skip tables from Stockfish 9), so they run ahead of the main thread and fill the table
+// with results it can use.
+constexpr int SKIP_PATTERNS = 20;
+constexpr int SKIP_SIZE[SKIP_PATTERNS] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+constexpr int SKIP_PHASE[SKIP_PATTERNS] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+auto skips_depth(int thread_id, int depth) -> bool {
+    if (thread_id == 0) return false;
+    int pattern = (thread_id - 1) % SKIP_PATTERNS;
+    return ((depth + SKIP_PHASE[pattern]) / SKIP_SIZE[pattern]) % 2;
+}
+
+class Vorpal {
+    TimeControl time_control = {-1, 0, 0, 1000};  // a second per move unless told otherwise
+    int move_overhead = 10;  // ms lost per move outside the engine
+    TimeManager time;
+    int contempt = 30;     // centipawns a draw is worth less than equality to the side to move at the root
+    int threads = 1;
+    U64 node_limit = 0;  // 0 for no limit
+    int tb_limit = Tablebase::MAX_MEN;  // most men on the board for a tablebase probe
+
+    std::vector<std::unique_ptr<Searcher>> searchers;
+    std::chrono::steady_clock::time_point start;
+
+    auto elapsed_ms() const -> U64 {
+        return (U64)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    auto total_nodes() const -> U64 {
+        U64 total = 0;
+        for (const auto& searcher : searchers) total += searcher->nodes.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    void print_info(const Searcher& searcher, int depth, int score) const {
+        U64 elapsed = elapsed_ms();
+        U64 nodes = total_nodes();
+        std::cout << "info depth " << depth << " seldepth " << searcher.seldepth << " score " << score_notation(score)
+                  << " nodes " << nodes << " nps " << nodes * 1000 / std::max<U64>(elapsed, 1)
+                  << " time " << elapsed << " pv";
+        for (int i = 0; i < searcher.pv_length[0]; i++) std::cout << " " << move_notation(searcher.pv[0][i]);
+        std::cout << std::endl;
+    }
+
+    // one thread's iterative deepening. the main thread (id 0) reports each iteration and
+    // decides when the search is over, the helpers run until it stops them.
+    auto iterate(Searcher& searcher, int thread_id, int max_depth) -> SearchResult {
+        SearchResult result;
+        const bool main_thread = thread_id == 0;
+        for (int depth = 1; depth <= max_depth; depth++) {
+            if (skips_depth(thread_id, depth)) continue;
+            searcher.seldepth = 0;
+            int score = searcher.aspiration(depth, result.score);
+            // a half-finished iteration is thrown away, unless depth 1 never finished either
+            if (stopped.load() && result.depth > 0) break;
+
+            result.best_move = searcher.best_move();
+            result.ponder_move = searcher.ponder_move();
+            result.score = score;
+            result.depth = depth;
+
+            if (!main_thread) {
+                if (stopped.load()) break;
+                continue;
+            }
+            if (verbose) print_info(searcher, depth, score);
+            if (stopped.load()) break;
+            time.update(result.best_move, score, depth);
+            if (!pondering.load() && time.should_stop()) break;
+            if (score >= MATE_BOUND || score <= -MATE_BOUND) {
+                if (depth >= MATE - std::abs(score)) break;
+            }
+        }
+        return result;
+    }
+
+    // the tablebase result of every root move, and the best of them: the quickest mate,
+    // else a draw, else the slowest loss. false if the tables don't have them all.
+    auto tablebase_move(const State& root, SearchResult& result) const -> bool {
+        State state = root;
+        result.best_move = NULL_MOVE;
+        result.score = -INF_SCORE;
+        for (Move move : state.legal_moves()) {
+            state.push(move);
+            uint8_t code;
+            bool found = Tablebase::TABLEBASES.probe(state, code);
+            state.pop(move);
+            if (!found) return false;
+            int score = -tablebase_score(code, 1, 0);
+            if (score > result.score) {
+                result.score = score;
+                result.best_move = move;
+            }
+        }
+        return !result.best_move.is_null();
+    }
+
+    // every thread's best move gets votes for how deep it searched and how good it thought
+    // the move was, and the thread whose move has the most votes wins, deepest first on a tie.
+    // a deeper helper often knows better than the main thread.
+    static auto vote(const std::vector<SearchResult>& results) -> SearchResult {
+        int min_score = INF_SCORE;
+        for (const SearchResult& r : results) {
+            if (r.depth > 0) min_score = std::min(min_score, r.score);
+        }
+        auto votes_for = [&](Move move) {
+            long long votes = 0;
+            for (const SearchResult& r : results) {
+                if (r.depth > 0 && r.best_move == move) votes += (long long)(r.score - min_score + 14) * r.depth;
+            }
+            return votes;
+        };
+        SearchResult best = results[0];
+        long long best_votes = best.depth > 0 ? votes_for(best.best_move) : -1;
+        for (const SearchResult& r : results) {
+            if (r.depth == 0 || r.best_move.is_null()) continue;
+            long long votes = votes_for(r.best_move);
+            bool better = votes > best_votes || (votes == best_votes && r.depth > best.depth);
+            // a shorter forced mate beats any number of votes, and a proven mate is never voted away
+            if (best.score >= MATE_BOUND) {
+                better = r.score > best.score;
+            } else if (r.score >= MATE_BOUND) {
+                better = true;
+            }
+            if (better) {
+                best = r;
+                best_votes = votes;
+            }
+        }
+        return best;
+    }
+
+   public:
+    // shared by every search thread, sized in MiB
+    TranspositionTable tt;
+    std::atomic<bool> stopped{false};
+    // while set the search ignores the clock, clear it (ponderhit) to put the clock back on
+    std::atomic<bool> pondering{false};
+    // print an info line after every iteration
+    bool verbose = true;
+    // played from before searching, while the position is in it
+    Polyglot::Book book;
+    // every thread's search statistics, summed over every search since construction
+    // (profiling builds only)
+    Profile::SearchStats stats;
+
+    // returns the size the table got in MiB, which is less than asked for if memory ran short
+    auto set_hash_size(size_t mb) -> size_t {
+        return tt.resize(mb) / (1024 * 1024);
+    }
+
+    // a fixed time per move, 0 for no limit
+    void set_time_limit(int ms) {
+        time_control = TimeControl();
+        if (ms > 0) time_control.movetime = ms;
+    }
+
+    // the clock to share out between the moves to come
+    void set_time_control(const TimeControl& control) {
+        time_control = control;
+    }
+
+    void set_move_overhead(int ms) {
+        move_overhead = std::max(0, ms);
+    }
+
+    // the opponent played the expected move: the clock is ours from now
+    void ponderhit() {
+        time.restart();
+        pondering.store(false);
+    }
+
+    void set_contempt(int cp) {
+        contempt = cp;
+    }
+
+    // counted on the main thread only, so with helpers the total is larger
+    void set_node_limit(U64 nodes) {
+        node_limit = nodes;
+    }
+
+    void set_tb_limit(int men) {
+        tb_limit = men;
+    }
+
+    void set_threads(int n) {
+        threads = std::max(1, n);
+    }
+
+    auto get_threads() const -> int {
+        return threads;
+    }
+
+    // searches up to max_depth or until the time control says to stop on every thread,
+    // unless the book has a move for the position or the tablebases know the result.
+    // a caller that may stop the search from another thread clears `stopped` itself before
+    // starting it and passes clear_stop = false, so that an early stop isn't lost.
+    auto search(const State& root, int max_depth = MAX_PLY - 1, bool clear_stop = true) -> SearchResult {
+        start = std::chrono::steady_clock::now();
+        if (clear_stop) stopped.store(false);
+        if (book.is_open()) {
+            SearchResult result;
+            result.best_move = book.pick(root);
+            if (!result.best_move.is_null()) {
+                if (verbose) std::cout << "info string book move " << move_notation(result.best_move) << std::endl;
+                return result;
+            }
+        }
+        if (popcount(root.occupied) <= tb_limit) {
+            SearchResult result;
+            if (tablebase_move(root, result)) {
+                if (verbose) {
+                    std::cout << "info string tablebase score " << score_notation(result.score) << " bestmove "
+                              << move_notation(result.best_move) << std::endl;
+                }
+                return result;
+            }
+        }
+        tt.new_search();
+        max_depth = std::min(max_depth, MAX_PLY - 1);
+
+        searchers.clear();
+        for (int i = 0; i < threads; i++) {
+            searchers.push_back(std::make_unique<Searcher>(root, tt, stopped));
+            searchers[i]->contempt = contempt;
+            searchers[i]->tb_limit = tb_limit;
+        }
+        time.start(time_control, move_overhead);
+        searchers[0]->time = time.is_limited() ? &time : nullptr;
+        searchers[0]->node_limit = node_limit;
+        searchers[0]->pondering = &pondering;
+
+        std::vector<SearchResult> results(threads);
+        std::vector<std::thread> helpers;
+        for (int i = 1; i < threads; i++) {
+            helpers.emplace_back([this, &results, i, max_depth] {
+                results[i] = iterate(*searchers[i], i, max_depth);
+            });
+        }
+        results[0] = iterate(*searchers[0], 0, max_depth);
+        stopped.store(true);
+        for (std::thread& helper : helpers) helper.join();
+        if constexpr (Profile::ENABLED) {
+            for (const auto& searcher : searchers) stats += searcher->stats;
+            stats.nodes += total_nodes();
+        }
+
+        SearchResult result = vote(results);
+        result.nodes = total_nodes();
+        // stopped before even depth 1 finished, any legal move beats none
+        if (result.best_move.is_null()) {
+            MoveList moves = root.legal_moves();
+            if (!moves.empty()) result.best_move = moves[0];
+        }
+        return result;
+    }
+};
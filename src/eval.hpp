@@ -0,0 +1,269 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "MaskSet.hpp"
+#include "intrinsic_functions.hpp"
+#include "movegen.hpp"
+#include "names.hpp"
+#include "nnue.hpp"
+#include "profile.hpp"
+#include "psqt.hpp"
+#include "state.hpp"
+
+// static evaluation, in centipawns from the point of view of the side to move.
+//
+// tapered: every term has a midgame and an endgame value (see psqt.hpp), and the two are
+// blended by how much material is left. material and piece-square values come from the
+// running total State keeps, so only mobility, pawn structure and king safety are worked
+// out here at the leaf.
+//
+// with a network loaded (see nnue.hpp) the network's output replaces all of this.
+
+namespace Eval {
+// per square a piece can move to, counted from a typical number of squares for that piece
+constexpr Score MOBILITY[6] = {S(0, 0), S(4, 4), S(5, 5), S(2, 4), S(1, 2), S(0, 0)};
+constexpr int MOBILITY_BASE[6] = {0, 4, 6, 7, 13, 0};
+
+constexpr Score BISHOP_PAIR = S(30, 50);
+
+constexpr Score DOUBLED_PAWN = S(-10, -20);
+constexpr Score ISOLATED_PAWN = S(-10, -15);
+constexpr Score BACKWARD_PAWN = S(-8, -10);
+// by rank, counted from the pawn's own side of the board
+constexpr Score PASSED_PAWN[8] = {S(0, 0), S(5, 10), S(10, 15), S(15, 25), S(25, 45), S(40, 70), S(60, 110), S(0, 0)};
+
+// per rank a passed pawn has come up, when nothing stands on the square in front of it
+constexpr Score FREE_PASSER = S(2, 6);
+
+// a knight or bishop in the enemy half that no enemy pawn can ever chase away,
+// standing on a square our pawns defend
+constexpr Score OUTPOST[2] = {S(20, 10), S(10, 5)};
+
+// our pawns directly in front of the king, one and two ranks up
+constexpr Score PAWN_SHIELD[2] = {S(12, 0), S(6, 0)};
+// how much each enemy piece's attacks on the squares around the king weigh
+constexpr int KING_ATTACK_WEIGHT[6] = {0, 2, 2, 3, 5, 0};
+constexpr int KING_DANGER_CAP = 500;
+
+constexpr auto adjacent_files(int file) -> U64 {
+    return (file > 0 ? BB_FILE_A << (file - 1) : 0) | (file < 7 ? BB_FILE_A << (file + 1) : 0);
+}
+
+// the squares in front of a pawn on its own and the neighbouring files, which have to
+// be clear of enemy pawns for it to be passed
+struct PassedMasks {
+    U64 masks[2][64];
+
+    constexpr PassedMasks() : masks{} {
+        for (int square = 0; square < 64; square++) {
+            int file = square % 8;
+            int rank = square / 8;
+            U64 files = (BB_FILE_A << file) | adjacent_files(file);
+            for (int r = 0; r < 8; r++) {
+                if (r > rank) masks[WHITE][square] |= files & (BB_RANK_1 << (8 * r));
+                if (r < rank) masks[BLACK][square] |= files & (BB_RANK_1 << (8 * r));
+            }
+        }
+    }
+};
+
+constexpr PassedMasks PASSED = PassedMasks();
+
+// counted from the colour's own back rank
+constexpr auto relative_rank(Colour colour, int square) -> int {
+    return colour == WHITE ? square / 8 : 7 - square / 8;
+}
+
+// everything the evaluation wants from the pawns alone. it depends only on the pawn
+// placement, so it is computed once per pawn structure and cached under the pawn key.
+struct PawnEntry {
+    U64 key;
+    Score score;         // doubled, isolated, backward and passed pawns, white's point of view
+    U64 passed[2];       // passed pawns of each colour
+    U64 attacks[2];      // squares each colour's pawns attack now
+    U64 attack_span[2];  // squares each colour's pawns attack now or could after advancing
+};
+
+constexpr auto fill_up(U64 bb) -> U64 {
+    bb |= bb << 8;
+    bb |= bb << 16;
+    return bb | (bb << 32);
+}
+
+constexpr auto fill_down(U64 bb) -> U64 {
+    bb |= bb >> 8;
+    bb |= bb >> 16;
+    return bb | (bb >> 32);
+}
+
+// every square a colour's pawns attack
+auto pawn_attacks(U64 pawns, Colour colour) -> U64 {
+    U64 west = pawns & ~BB_FILE_A;
+    U64 east = pawns & ~BB_FILE_H;
+    return colour == WHITE ? (west << 7) | (east << 9) : (west >> 9) | (east >> 7);
+}
+
+void evaluate_pawns(const State& state, PawnEntry& entry) {
+    entry.key = state.pawn_key;
+    entry.score = 0;
+    U64 pawns[2] = {state.pieces[PAWN] & state.occupied_co[WHITE], state.pieces[PAWN] & state.occupied_co[BLACK]};
+    for (Colour colour : {WHITE, BLACK}) {
+        entry.attacks[colour] = pawn_attacks(pawns[colour], colour);
+        entry.attack_span[colour] = colour == WHITE ? fill_up(entry.attacks[colour]) : fill_down(entry.attacks[colour]);
+    }
+    for (Colour colour : {WHITE, BLACK}) {
+        Score side = 0;
+        U64 ours = pawns[colour];
+        U64 theirs = pawns[!colour];
+        for (int file = 0; file < 8; file++) {
+            int count = popcount(ours & (BB_FILE_A << file));
+            if (count > 1) side += DOUBLED_PAWN * (count - 1);
+            if (count && !(ours & adjacent_files(file))) side += ISOLATED_PAWN * count;
+        }
+        // backward: the square in front is covered by an enemy pawn, and no pawn of ours
+        // can ever come up alongside to cover it
+        U64 stops = colour == WHITE ? ours << 8 : ours >> 8;
+        U64 weak_stops = stops & entry.attacks[!colour] & ~entry.attack_span[colour];
+        side += BACKWARD_PAWN * popcount(weak_stops);
+
+        entry.passed[colour] = 0;
+        for (U64 bb = ours; bb; bb &= bb - 1) {
+            Square square = bitscan_forward(bb);
+            if (!(PASSED.masks[colour][square] & theirs)) {
+                entry.passed[colour] |= 1ULL << square;
+                side += PASSED_PAWN[relative_rank(colour, square)];
+            }
+        }
+        entry.score += colour == WHITE ? side : -side;
+    }
+}
+
+// a small direct-mapped cache of pawn entries, one per search thread so there is no sharing.
+// a zeroed entry is the correct entry for key 0 (no pawns at all), so it needs no valid flag.
+class PawnTable {
+    std::vector<PawnEntry> entries;
+    U64 mask;
+
+   public:
+    U64 hits = 0;
+    U64 misses = 0;
+
+    PawnTable(size_t size = 1 << 13) : entries(size, PawnEntry{}), mask(size - 1) {}
+
+    auto probe(const State& state) -> const PawnEntry& {
+        PawnEntry& entry = entries[state.pawn_key & mask];
+        if (entry.key == state.pawn_key) {
+            hits++;
+        } else {
+            misses++;
+            evaluate_pawns(state, entry);
+        }
+        return entry;
+    }
+};
+
+// mobility for one side's pieces, and the attack weight they bring against the enemy king.
+// squares held by our own pieces or covered by enemy pawns don't count as mobility.
+auto piece_activity(const State& state, const PawnEntry& pawns, Colour colour, int& king_attack) -> Score {
+    Score score = 0;
+    U64 ours = state.occupied_co[colour];
+    U64 safe = ~ours & ~pawns.attacks[!colour];
+    U64 enemy_half = colour == WHITE ? BB_RANK_5 | BB_RANK_6 | BB_RANK_7 : BB_RANK_4 | BB_RANK_3 | BB_RANK_2;
+    U64 outposts = enemy_half & pawns.attacks[colour] & ~pawns.attack_span[!colour];
+    Square their_king = bitscan_forward(state.pieces[KING] & state.occupied_co[!colour]);
+    U64 king_zone = BB_KING_ATTACKS[their_king] | (1ULL << their_king);
+    int attackers = 0;
+    king_attack = 0;
+    for (int piece = KNIGHT; piece <= QUEEN; piece++) {
+        for (U64 bb = state.pieces[piece] & ours; bb; bb &= bb - 1) {
+            Square square = bitscan_forward(bb);
+            U64 attacks;
+            if (piece == KNIGHT) {
+                attacks = BB_KNIGHT_ATTACKS[square];
+            } else if (piece == BISHOP) {
+                attacks = get_bishop_moves(square, state.occupied);
+            } else if (piece == ROOK) {
+                attacks = get_rook_moves(square, state.occupied);
+            } else {
+                attacks = get_queen_moves(square, state.occupied);
+            }
+            score += MOBILITY[piece] * (popcount(attacks & safe) - MOBILITY_BASE[piece]);
+            if (piece <= BISHOP && (outposts & (1ULL << square))) score += OUTPOST[piece - KNIGHT];
+            if (attacks & king_zone) {
+                attackers++;
+                king_attack += KING_ATTACK_WEIGHT[piece] * popcount(attacks & king_zone);
+            }
+        }
+    }
+    // a lone attacker isn't much of a threat
+    if (attackers < 2) king_attack = 0;
+    return score;
+}
+
+// the pawns sheltering a king, one and two ranks in front of it
+auto pawn_shield(const State& state, Colour colour) -> Score {
+    Square king = bitscan_forward(state.pieces[KING] & state.occupied_co[colour]);
+    U64 files = (BB_FILE_A << (king % 8)) | adjacent_files(king % 8);
+    U64 pawns = state.pieces[PAWN] & state.occupied_co[colour] & files;
+    int rank = king / 8;
+    int up = colour == WHITE ? 1 : -1;
+    Score score = 0;
+    for (int i = 0; i < 2; i++) {
+        int r = rank + up * (i + 1);
+        if (r < 0 || r > 7) break;
+        score += PAWN_SHIELD[i] * popcount(pawns & (BB_RANK_1 << (8 * r)));
+    }
+    return score;
+}
+
+// passed pawns with nothing in the way are worth more, which depends on more than the pawns
+auto free_passers(const State& state, const PawnEntry& pawns, Colour colour) -> Score {
+    Score score = 0;
+    for (U64 bb = pawns.passed[colour]; bb; bb &= bb - 1) {
+        Square square = bitscan_forward(bb);
+        Square stop = (Square)(square + PAWN_STEP[colour]);
+        if (!(state.occupied & (1ULL << stop))) score += FREE_PASSER * relative_rank(colour, square);
+    }
+    return score;
+}
+
+auto king_danger(int attack) -> Score {
+    return S(-std::min(attack * attack / 2, KING_DANGER_CAP), 0);
+}
+
+// blends the midgame and endgame halves by the phase
+auto taper(Score score, int phase) -> int {
+    phase = std::min(phase, Psqt::PHASE_TOTAL);
+    return (mg_value(score) * phase + eg_value(score) * (Psqt::PHASE_TOTAL - phase)) / Psqt::PHASE_TOTAL;
+}
+};  // namespace Eval
+
+// with the pawn terms from a thread's pawn hash table
+auto evaluate(const State& state, Eval::PawnTable& pawn_table) -> int {
+    Profile::Scope scope(Profile::EVALUATE);
+    if (Nnue::ACTIVE) return Nnue::evaluate(state.accumulator, state.turn);
+    const Eval::PawnEntry& pawns = pawn_table.probe(state);
+    Score score = state.psqt + pawns.score;
+
+    int white_attack, black_attack;
+    score += Eval::piece_activity(state, pawns, WHITE, white_attack);
+    score -= Eval::piece_activity(state, pawns, BLACK, black_attack);
+    // white's attack endangers the black king and vice versa
+    score += Eval::king_danger(black_attack) - Eval::king_danger(white_attack);
+    score += Eval::pawn_shield(state, WHITE) - Eval::pawn_shield(state, BLACK);
+    score += Eval::free_passers(state, pawns, WHITE) - Eval::free_passers(state, pawns, BLACK);
+
+    if (popcount(state.pieces[BISHOP] & state.occupied_co[WHITE]) >= 2) score += Eval::BISHOP_PAIR;
+    if (popcount(state.pieces[BISHOP] & state.occupied_co[BLACK]) >= 2) score -= Eval::BISHOP_PAIR;
+
+    int value = Eval::taper(score, state.phase);
+    return state.turn == WHITE ? value : -value;
+}
+
+// one-off evaluation, with a throwaway single-entry pawn table
+auto evaluate(const State& state) -> int {
+    Eval::PawnTable pawn_table(1);
+    return evaluate(state, pawn_table);
+}
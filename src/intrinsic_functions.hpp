@@ -9,10 +9,10 @@ auto bitscan_forward(U64 bb) -> Square {
 
 // A bitscan reverse is used to find the index of the most significant 1 bit (MS1B).
 auto bitscan_reverse(U64 bb) -> Square {
-    return (Square)__builtin_clzll(bb);
+    return (Square)(63 - __builtin_clzll(bb));
 }
 
-// note: ctz vs clz builtins in the above functions
+// note: ctz vs clz builtins in the above functions, clz counts from the top so it is flipped
 
 // counts set bits
 auto popcount(U64 bb) -> int {
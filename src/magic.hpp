@@ -0,0 +1,155 @@
+#pragma once
+
+#include "intrinsic_functions.hpp"
+#include "names.hpp"
+
+using U64 = unsigned long long;
+
+// "fancy" magic bitboards for the sliding pieces.
+// the blockers that matter to a slider on a given square are masked out, multiplied
+// by a per-square magic constant, and the top bits of the product index straight into
+// a table of pregenerated attack sets, so a lookup is one AND, one multiply and one shift.
+// the magics were found offline by trial of sparse random numbers, the tables are
+// filled once at startup from a slow ray-walker.
+
+namespace Magic {
+constexpr U64 BISHOP_MAGICS[64] = {
+    0x10102002004a1420ULL, 0x8020040400584008ULL, 0x10510800811201c8ULL, 0x5204042080000088ULL,
+    0x2204106880000002ULL, 0x1401042004000000ULL, 0x0400880410042004ULL, 0x0028208200a02020ULL,
+    0x1500241990010e00ULL, 0x8001200182020a40ULL, 0x40004101030b0000ULL, 0x8002041042000100ULL,
+    0x4010011041020038ULL, 0x0000010421044000ULL, 0x1500210808020a00ULL, 0x8000088400880520ULL,
+    0x0405004010040100ULL, 0x1005823210040108ULL, 0x2708008102040011ULL, 0x4048200404009100ULL,
+    0x0018104101400024ULL, 0x0003000601190101ULL, 0x8004803108491000ULL, 0x8014241200820800ULL,
+    0x0006e080100c3040ULL, 0x0501044a11041800ULL, 0x9020300008004045ULL, 0x0894080000220040ULL,
+    0x1001010083104000ULL, 0x5004030040900080ULL, 0x000400422c012400ULL, 0x0002128698404812ULL,
+    0x1010108404900440ULL, 0x0928021182084100ULL, 0x2006080409020024ULL, 0x1010202020180080ULL,
+    0xa010008200202200ULL, 0x2098015100019004ULL, 0x0002041440810811ULL, 0x802a02020000b098ULL,
+    0x0009015090004060ULL, 0x4000821082081001ULL, 0x0100210040420800ULL, 0x0800004010488a00ULL,
+    0x2000081104004040ULL, 0x4c8e029015000082ULL, 0x0420340322224842ULL, 0x1298260043400210ULL,
+    0x0000822802400008ULL, 0x00008a0101600000ULL, 0x3040003412080021ULL, 0x3040290220884800ULL,
+    0x4a1500401041004aULL, 0x8010200282020781ULL, 0x0020203142209091ULL, 0x0070300600902110ULL,
+    0x0040808800b62048ULL, 0x0000810400c44420ULL, 0x00080400440c0441ULL, 0x8340080020840411ULL,
+    0x0000000104208200ULL, 0x0000800810d00080ULL, 0x0400530411080200ULL, 0x4040702400932244ULL};
+
+constexpr U64 ROOK_MAGICS[64] = {
+    0x1080004008801020ULL, 0x0840092002c03000ULL, 0x1900200010400900ULL, 0x0880100008000480ULL,
+    0x4200100420080200ULL, 0x8100020100080400ULL, 0x0200040110886200ULL, 0x0200008040220411ULL,
+    0x0404800084400220ULL, 0x0000401000402000ULL, 0x0086001081220440ULL, 0x0408800800100280ULL,
+    0x000a001201040820ULL, 0x8848800200840080ULL, 0x4001000100040200ULL, 0x0442000102105084ULL,
+    0x9080010020804100ULL, 0x0040404000201009ULL, 0x0000808010002009ULL, 0x2200090021d00100ULL,
+    0x0008008008040080ULL, 0x0004004002010040ULL, 0x0011040008015042ULL, 0x00000a0001768104ULL,
+    0x0000800080204009ULL, 0x2010004140002001ULL, 0x9800200280100080ULL, 0x1000100080080080ULL,
+    0x0442000a00049020ULL, 0x2100040080020080ULL, 0x0800120400900148ULL, 0x0010040a00128541ULL,
+    0x2800804000800030ULL, 0x1010002000400041ULL, 0x4000200011004100ULL, 0x0610008410800800ULL,
+    0x0400802402800800ULL, 0xc100020080800400ULL, 0x0002000802000401ULL, 0x0182085882000401ULL,
+    0x0220204000808000ULL, 0x2860100040024022ULL, 0x0001002004110040ULL, 0x99101042000a0020ULL,
+    0x0004080004008080ULL, 0x0010040002008080ULL, 0x2012004881020004ULL, 0x8300842444820011ULL,
+    0x0088403882010200ULL, 0x0820400080210100ULL, 0x0110910040a00300ULL, 0x0801100280080480ULL,
+    0x0242009008200600ULL, 0x1002000489500200ULL, 0x0040800200010080ULL, 0x0091800041000080ULL,
+    0x0000209300488001ULL, 0x04c1002414824001ULL, 0x020020000b001041ULL, 0x7000100004200901ULL,
+    0x8002002004100802ULL, 0x30010002084c0007ULL, 0x0888221800813004ULL, 0x4000002840840112ULL};
+
+// (rank, file) steps for the four rays of each slider
+constexpr int BISHOP_DELTAS[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+constexpr int ROOK_DELTAS[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+
+// the summed sizes of the per-square tables, 2^(relevant bits) for every square
+constexpr int BISHOP_TABLE_SIZE = 5248;
+constexpr int ROOK_TABLE_SIZE = 102400;
+
+struct Entry {
+    U64 mask;
+    U64 magic;
+    U64* attacks;
+    int shift;
+
+    auto index(U64 blockers) const -> unsigned {
+        return ((blockers & mask) * magic) >> shift;
+    }
+};
+
+// walks each ray until it falls off the board or hits a blocker, only used to fill the tables
+auto sliding_attacks(int square, U64 blockers, const int deltas[4][2]) -> U64 {
+    U64 attacks = 0;
+    for (int dir = 0; dir < 4; dir++) {
+        int rank = square / 8 + deltas[dir][0];
+        int file = square % 8 + deltas[dir][1];
+        while (rank >= 0 && rank < 8 && file >= 0 && file < 8) {
+            U64 bb = 1ULL << (rank * 8 + file);
+            attacks |= bb;
+            if (bb & blockers) break;
+            rank += deltas[dir][0];
+            file += deltas[dir][1];
+        }
+    }
+    return attacks;
+}
+
+// the mask of squares whose occupancy can change a slider's attacks.
+// the edge of the board never blocks anything further, unless the slider is on that edge.
+auto relevant_blockers(int square, const int deltas[4][2]) -> U64 {
+    U64 edges = (BB_BACKRANKS & ~(BB_RANK_1 << (square / 8 * 8))) |
+                ((BB_FILE_A | BB_FILE_H) & ~(BB_FILE_A << (square % 8)));
+    return sliding_attacks(square, 0, deltas) & ~edges;
+}
+
+class Tables {
+   public:
+    Entry bishops[64];
+    Entry rooks[64];
+    U64 bishop_attacks[BISHOP_TABLE_SIZE];
+    U64 rook_attacks[ROOK_TABLE_SIZE];
+
+    Tables() {
+        fill(bishops, bishop_attacks, BISHOP_MAGICS, BISHOP_DELTAS);
+        fill(rooks, rook_attacks, ROOK_MAGICS, ROOK_DELTAS);
+    }
+
+   private:
+    static void fill(Entry entries[64], U64* table, const U64 magics[64], const int deltas[4][2]) {
+        U64* next = table;
+        for (int square = 0; square < 64; square++) {
+            Entry& e = entries[square];
+            e.mask = relevant_blockers(square, deltas);
+            e.magic = magics[square];
+            e.attacks = next;
+            e.shift = 64 - popcount(e.mask);
+            // enumerate every subset of the mask with the carry-rippler trick
+            U64 blockers = 0;
+            do {
+                e.attacks[e.index(blockers)] = sliding_attacks(square, blockers, deltas);
+                blockers = (blockers - e.mask) & e.mask;
+            } while (blockers);
+            next += 1ULL << popcount(e.mask);
+        }
+    }
+};
+
+#if defined(VORPAL_SLIDERS_PEXT)
+// a PEXT build only looks the magics up in the slider benchmark, so they're built on first use
+auto tables() -> const Tables& {
+    static const Tables tables;
+    return tables;
+}
+#else
+const Tables TABLES;
+
+auto tables() -> const Tables& {
+    return TABLES;
+}
+#endif
+};  // namespace Magic
+
+auto get_bishop_moves_m(const Square square, const U64 blockers) -> U64 {
+    const Magic::Entry& e = Magic::tables().bishops[square];
+    return e.attacks[e.index(blockers)];
+}
+
+auto get_rook_moves_m(const Square square, const U64 blockers) -> U64 {
+    const Magic::Entry& e = Magic::tables().rooks[square];
+    return e.attacks[e.index(blockers)];
+}
+
+auto get_queen_moves_m(const Square square, const U64 blockers) -> U64 {
+    return get_bishop_moves_m(square, blockers) | get_rook_moves_m(square, blockers);
+}
@@ -1,15 +1,214 @@
+
+#include <chrono>
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <vector>
 
 #include "MaskSet.hpp"
+#include "analysis.hpp"
+#include "benchmarks.hpp"
+#include "book.hpp"
 #include "engine.hpp"
 #include "intrinsic_functions.hpp"
 #include "move.hpp"
 #include "movegen.hpp"
 #include "names.hpp"
+#include "nnue.hpp"
+#include "perft.hpp"
+#include "profile.hpp"
 #include "state.hpp"
+#include "tablebase.hpp"
+#include "uci.hpp"
 #include "vorpal_helpers.hpp"
 
+const std::string STARTPOS_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// vorpal [uci]                             speaks UCI on stdin and stdout
+// vorpal perft [depth] [--no-bulk]         runs the perft suite, exits non-zero on a wrong count
+// vorpal divide <depth> [fen] [--no-bulk]  perft split by root move
+// vorpal sliders                           slider attack backend benchmark
+// vorpal search <ms> [fen]                 searches a position for ms milliseconds
+// vorpal smp [depth] [max threads]         lazy SMP time-to-depth benchmark
+// vorpal nnue                              network evaluation speed benchmark
+// vorpal book <path> [fen]                 lists a polyglot book's moves for a position
+// vorpal tbgen <dir> <table>...            generates tablebases (e.g. KQvKR) and what they need
+// vorpal analyse <file>                    analyses every FEN/EPD line of a file ("-" for stdin)
+// vorpal bench                             searches a fixed suite to a fixed depth, prints the node signature
+//
+// --threads <n> sets the number of search threads (for analyse, of single-threaded workers)
+// --depth <n>, --nodes <n> and --hash <mb> limit each analyse search and size its hash table,
+// and set bench's depth (9 by default) and hash size
+//
+// built with -DVORPAL_PROFILE, search and bench also write per-function cycle counts and
+// search statistics to stderr as JSON (see profile.hpp)
+// --eval-file <path> evaluates with the network in that file
+// --book <path> plays from a polyglot opening book while it has moves
+// --tb <dir> probes the tablebases in dir, --tb-limit <n> only with n men or fewer
 int main(int argc, char const *argv[]) {
-    std::cout << "Vorpal running...";
-    return 0;
+    std::vector<std::string> args(argv + 1, argv + argc);
+    bool bulk = true;
+    int threads = 1;
+    std::string book_path;
+    int tb_limit = Tablebase::MAX_MEN;
+    Analysis::Limits limits;
+    bool depth_given = false;
+    for (auto it = args.begin(); it != args.end();) {
+        if (*it == "--no-bulk") {
+            bulk = false;
+            it = args.erase(it);
+        } else if (*it == "--threads" && it + 1 != args.end()) {
+            threads = std::stoi(*(it + 1));
+            it = args.erase(it, it + 2);
+        } else if (*it == "--eval-file" && it + 1 != args.end()) {
+            if (!Nnue::load(*(it + 1))) {
+                std::cerr << "can't load network " << *(it + 1) << "\n";
+                return 1;
+            }
+            it = args.erase(it, it + 2);
+        } else if (*it == "--tb" && it + 1 != args.end()) {
+            Tablebase::TABLEBASES.init(*(it + 1));
+            it = args.erase(it, it + 2);
+        } else if (*it == "--tb-limit" && it + 1 != args.end()) {
+            tb_limit = std::stoi(*(it + 1));
+            it = args.erase(it, it + 2);
+        } else if (*it == "--depth" && it + 1 != args.end()) {
+            limits.depth = std::stoi(*(it + 1));
+            depth_given = true;
+            it = args.erase(it, it + 2);
+        } else if (*it == "--nodes" && it + 1 != args.end()) {
+            limits.nodes = std::stoull(*(it + 1));
+            it = args.erase(it, it + 2);
+        } else if (*it == "--hash" && it + 1 != args.end()) {
+            limits.hash_mb = (size_t)std::max(1, std::stoi(*(it + 1)));
+            it = args.erase(it, it + 2);
+        } else if (*it == "--book" && it + 1 != args.end()) {
+            book_path = *(it + 1);
+            it = args.erase(it, it + 2);
+        } else {
+            ++it;
+        }
+    }
+
+    if (!args.empty() && args[0] == "sliders") {
+        Bench::slider_attacks();
+        return 0;
+    }
+    if (!args.empty() && args[0] == "perft") {
+        int depth = args.size() > 1 ? std::stoi(args[1]) : 5;
+        return Perft::run_suite(depth, bulk) ? 0 : 1;
+    }
+    if (!args.empty() && args[0] == "divide") {
+        int depth = args.size() > 1 ? std::stoi(args[1]) : 1;
+        std::string fen = STARTPOS_FEN;
+        if (args.size() > 2) {
+            fen.clear();
+            for (size_t i = 2; i < args.size(); i++) fen += args[i] + " ";
+        }
+        State state;
+        if (!state.load_fen(fen)) {
+            std::cerr << "invalid FEN " << fen << "\n";
+            return 1;
+        }
+        Perft::divide(state, depth, bulk);
+        return 0;
+    }
+    if (!args.empty() && args[0] == "search") {
+        int ms = args.size() > 1 ? std::stoi(args[1]) : 1000;
+        std::string fen = STARTPOS_FEN;
+        if (args.size() > 2) {
+            fen.clear();
+            for (size_t i = 2; i < args.size(); i++) fen += args[i] + " ";
+        }
+        State state;
+        if (!state.load_fen(fen)) {
+            std::cerr << "invalid FEN " << fen << "\n";
+            return 1;
+        }
+        Vorpal engine;
+        engine.set_time_limit(ms);
+        engine.set_threads(threads);
+        engine.set_tb_limit(tb_limit);
+        if (!book_path.empty() && !engine.book.open(book_path)) {
+            std::cerr << "can't open book " << book_path << "\n";
+            return 1;
+        }
+        SearchResult result = engine.search(state);
+        std::cout << "bestmove " << move_notation(result.best_move) << std::endl;
+        if constexpr (Profile::ENABLED) Profile::write_json(std::cerr, engine.stats);
+        return 0;
+    }
+    if (!args.empty() && args[0] == "smp") {
+        int depth = args.size() > 1 ? std::stoi(args[1]) : 12;
+        int max_threads = args.size() > 2 ? std::stoi(args[2]) : 32;
+        Bench::smp_speedup(depth, max_threads);
+        return 0;
+    }
+    if (args.size() > 1 && args[0] == "book") {
+        std::string fen = STARTPOS_FEN;
+        if (args.size() > 2) {
+            fen.clear();
+            for (size_t i = 2; i < args.size(); i++) fen += args[i] + " ";
+        }
+        State state;
+        if (!state.load_fen(fen)) {
+            std::cerr << "invalid FEN " << fen << "\n";
+            return 1;
+        }
+        Polyglot::Book book;
+        if (!book.open(args[1])) {
+            std::cerr << "can't open book " << args[1] << "\n";
+            return 1;
+        }
+        std::cout << "key " << std::hex << Polyglot::key(state) << std::dec << "\n";
+        for (const Polyglot::BookMove& m : book.probe(state)) {
+            std::cout << move_notation(m.move) << " " << m.weight << "\n";
+        }
+        return 0;
+    }
+    if (args.size() > 2 && args[0] == "tbgen") {
+        Tablebase::TABLEBASES.init(args[1]);
+        for (size_t i = 2; i < args.size(); i++) {
+            Tablebase::Signature signature;
+            if (!Tablebase::parse_signature(args[i], signature)) {
+                std::cerr << "not a table: " << args[i] << "\n";
+                return 1;
+            }
+            if (!Tablebase::generate(args[1], signature)) return 1;
+        }
+        return 0;
+    }
+    if (args.size() > 1 && args[0] == "analyse") {
+        // with neither limit given, a depth that takes a fraction of a second
+        if (!depth_given && limits.nodes == 0) limits.depth = 10;
+        limits.tb_limit = tb_limit;
+        std::ifstream file;
+        if (args[1] != "-") {
+            file.open(args[1]);
+            if (!file) {
+                std::cerr << "can't open " << args[1] << "\n";
+                return 1;
+            }
+        }
+        auto start = std::chrono::steady_clock::now();
+        U64 positions = Analysis::run(args[1] == "-" ? std::cin : file, std::cout, threads, limits);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << positions << " positions in " << seconds << "s with " << threads << " threads\n";
+        return 0;
+    }
+    if (!args.empty() && args[0] == "bench") {
+        Bench::search_bench(depth_given ? limits.depth : 9, threads, limits.hash_mb);
+        return 0;
+    }
+    if (!args.empty() && args[0] == "nnue") {
+        Bench::nnue_evals();
+        return 0;
+    }
+    if (args.empty() || args[0] == "uci") {
+        Uci uci;
+        uci.loop();
+        return 0;
+    }
+    std::cerr << "unknown command " << args[0] << "\n";
+    return 1;
 }
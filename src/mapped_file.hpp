@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// a read-only file mapped into memory. the pages are only read in as they're touched,
+// so a file of any size opens instantly and costs memory for just the parts in use.
+class MappedFile {
+    const unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+#if defined(_WIN32)
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+
+   public:
+    MappedFile() = default;
+    ~MappedFile() {
+        close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    auto operator=(const MappedFile&) -> MappedFile& = delete;
+
+    auto data() const -> const unsigned char* {
+        return data_;
+    }
+
+    auto size() const -> size_t {
+        return size_;
+    }
+
+    auto is_open() const -> bool {
+        return data_ != nullptr;
+    }
+
+    // random_access says the file will be read all over rather than front to back,
+    // so reading ahead would only waste I/O
+    auto open(const std::string& path, bool random_access = true) -> bool {
+        close();
+#if defined(_WIN32)
+        (void)random_access;
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER file_size;
+        GetFileSizeEx(file, &file_size);
+        size_ = (size_t)file_size.QuadPart;
+        mapping = size_ ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+        data_ = mapping ? (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            size_ = (size_t)info.st_size;
+            void* mapped = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+            if (mapped != MAP_FAILED) {
+                data_ = (const unsigned char*)mapped;
+                if (random_access) madvise(mapped, size_, MADV_RANDOM);
+            }
+        }
+        ::close(fd);
+#endif
+        if (!data_) close();
+        return data_ != nullptr;
+    }
+
+    void close() {
+#if defined(_WIN32)
+        if (data_) UnmapViewOfFile(data_);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data_) munmap((void*)data_, size_);
+#endif
+        data_ = nullptr;
+        size_ = 0;
+    }
+};
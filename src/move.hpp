@@ -1,14 +1,17 @@
 #pragma once
 
+#include "intrinsic_functions.hpp"
 #include "names.hpp"
 
 class Move {
     uint m_Move;  // or short or template type
 
+   public:
+    Move() = default;
+
     // first four bits are flags, next 6: from_square, last 6: to_square
-    Move(Square from, Square to, uint flags) noexcept {
-        m_Move = ((flags & 0b1111) << 12) | ((from & 0b111111) << 6) | (to & 0b111111);
-    }
+    constexpr Move(Square from, Square to, uint flags) noexcept
+        : m_Move(((flags & 0b1111) << 12) | ((from & 0b111111) << 6) | (to & 0b111111)) {}
 
     // assignment just takes the integer
     void operator=(Move a) { m_Move = a.m_Move; }
@@ -20,9 +23,6 @@ class Move {
     // returns the 4-bit flags
     uint get_flags() const { return (m_Move >> 12) & 0x0f; }
 
-    // as the flags are the MSBs, and they order by promotion, capture, whatever, the internal integer works as a rudimentary ordering key
-    uint get_sort_key() const { return m_Move; }
-
     // set the square that the move is going to
     void set_to(uint to) {
         m_Move &= ~0x3f;
@@ -35,13 +35,128 @@ class Move {
         m_Move |= (from & 0x3f) << 6;
     }
 
-    bool is_capture() const { return m_Move & CAPTURE_FLAG; }
-    bool is_promotion() const { return m_Move & PROMOTION_FLAG; }
+    bool is_capture() const { return get_flags() & CAPTURE_FLAG; }
+    bool is_promotion() const { return get_flags() & PROMOTION_FLAG; }
 
     bool operator==(Move a) const { return (m_Move & 0xffff) == (a.m_Move & 0xffff); }
     bool operator!=(Move a) const { return (m_Move & 0xffff) != (a.m_Move & 0xffff); }
 
     unsigned short as_short() const { return (unsigned short)m_Move; }
+
+    // a1a1 can never be a real move, so the all-zero move stands for "no move"
+    bool is_null() const { return (m_Move & 0xffff) == 0; }
+};
+
+constexpr Move NULL_MOVE = Move(A1, A1, QUIET_MOVE_FLAG);
+
+// the most moves any legal chess position has is 218, so 256 always fits
+constexpr int MAX_MOVES = 256;
+
+// a fixed-capacity list of moves that lives on the stack, so generating moves never
+// touches the allocator. it has the parts of the std::vector interface the generators use.
+class MoveList {
+    Move moves[MAX_MOVES];
+    int count = 0;
+
+   public:
+    template <typename... Args>
+    void emplace_back(Args... args) { moves[count++] = Move(args...); }
+    void push_back(Move move) { moves[count++] = move; }
+    void pop_back() { count--; }
+    void clear() { count = 0; }
+
+    auto size() const -> int { return count; }
+    auto empty() const -> bool { return count == 0; }
+
+    auto operator[](int i) -> Move& { return moves[i]; }
+    auto operator[](int i) const -> Move { return moves[i]; }
+
+    auto begin() -> Move* { return moves; }
+    auto end() -> Move* { return moves + count; }
+    auto begin() const -> const Move* { return moves; }
+    auto end() const -> const Move* { return moves + count; }
+};
+
+// the generators hand their moves to a sink, as a from-square and a set of target squares,
+// or (from the set-wise pawn generator) as a set of targets that each came from the square
+// a fixed offset behind them. MoveSink writes the moves out into a MoveList, CountSink only counts them, which is
+// how State::num_legal_moves() avoids materialising any moves at all.
+
+class MoveSink {
+    MoveList& list;
+
+   public:
+    MoveSink(MoveList& l) : list(l) {}
+
+    void add(Square from_square, U64 targets, uint flags) {
+        while (targets) {
+            list.emplace_back(from_square, bitscan_forward(targets), flags);
+            targets &= targets - 1;
+        }
+    }
+
+    // every target gets all four promotions, flags is CAPTURE_FLAG or QUIET_MOVE_FLAG
+    void add_promotions(Square from_square, U64 targets, uint flags) {
+        while (targets) {
+            Square to_square = bitscan_forward(targets);
+            list.emplace_back(from_square, to_square, KNIGHT_PROMOTION_FLAG | flags);
+            list.emplace_back(from_square, to_square, BISHOP_PROMOTION_FLAG | flags);
+            list.emplace_back(from_square, to_square, ROOK_PROMOTION_FLAG | flags);
+            list.emplace_back(from_square, to_square, QUEEN_PROMOTION_FLAG | flags);
+            targets &= targets - 1;
+        }
+    }
+
+    // each target's from-square is target - offset
+    void add_shifted(U64 targets, int offset, uint flags) {
+        while (targets) {
+            Square to_square = bitscan_forward(targets);
+            list.emplace_back((Square)(to_square - offset), to_square, flags);
+            targets &= targets - 1;
+        }
+    }
+
+    void add_shifted_promotions(U64 targets, int offset, uint flags) {
+        while (targets) {
+            Square to_square = bitscan_forward(targets);
+            add_promotions((Square)(to_square - offset), 1ULL << to_square, flags);
+            targets &= targets - 1;
+        }
+    }
+};
+
+class CountSink {
+   public:
+    int count = 0;
+
+    void add(Square from_square, U64 targets, uint flags) { count += popcount(targets); }
+    void add_promotions(Square from_square, U64 targets, uint flags) { count += 4 * popcount(targets); }
+    void add_shifted(U64 targets, int offset, uint flags) { count += popcount(targets); }
+    void add_shifted_promotions(U64 targets, int offset, uint flags) { count += 4 * popcount(targets); }
+};
+
+// looks for one particular move among the generated ones
+class FindSink {
+    Move target;
+
+   public:
+    bool found = false;
+
+    FindSink(Move move) : target(move) {}
+
+    void add(Square from_square, U64 targets, uint flags) {
+        found |= from_square == target.get_from() && flags == target.get_flags() && (targets & (1ULL << target.get_to()));
+    }
+    void add_promotions(Square from_square, U64 targets, uint flags) {
+        found |= from_square == target.get_from() && (flags | PROMOTION_FLAG) == (target.get_flags() & ~0b11) &&
+                 (targets & (1ULL << target.get_to()));
+    }
+    void add_shifted(U64 targets, int offset, uint flags) {
+        add((Square)(target.get_to() - offset), targets, flags);
+    }
+    void add_shifted_promotions(U64 targets, int offset, uint flags) {
+        add_promotions((Square)(target.get_to() - offset), targets, flags);
+    }
 };
 
 // | code | promotion | capture | special 1 | special 0 | kind of move
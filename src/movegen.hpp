@@ -1,44 +1,59 @@
 #pragma once
 
+#include "MaskSet.hpp"
 #include "intrinsic_functions.hpp"
+#include "magic.hpp"
 #include "names.hpp"
+#include "profile.hpp"
 
-auto get_bishop_moves_c(const Square square, const U64 blockers, const MaskSet* masks) -> U64 {
+// slider attack backend, chosen at build time:
+//   (default)                  magic bitboards, magic.hpp
+//   -DVORPAL_SLIDERS_PEXT      PEXT-indexed tables, pext.hpp (needs -mbmi2, checked against CPUID at startup)
+//   -DVORPAL_SLIDERS_PORTABLE  the ray-walking functions below, no tables at all
+#if defined(VORPAL_SLIDERS_PEXT) && defined(VORPAL_SLIDERS_PORTABLE)
+#error "pick at most one of VORPAL_SLIDERS_PEXT and VORPAL_SLIDERS_PORTABLE"
+#endif
+
+#if defined(VORPAL_SLIDERS_PEXT)
+#include "pext.hpp"
+#endif
+
+auto get_bishop_moves_c(const Square square, const U64 blockers) -> U64 {
     U64 attacks = 0;
 
     // North West
     // OR-on the northwest ray to the attacks accumulator
-    attacks |= masks->RAYS[NORTH_WEST][square];
+    attacks |= MASKS.RAYS[NORTH_WEST][square];
     // if there's a blocker on the northwest ray
-    if (masks->RAYS[NORTH_WEST][square] & blockers) {
+    if (MASKS.RAYS[NORTH_WEST][square] & blockers) {
         // find blocker index
-        int blockerIndex = bitscan_forward(masks->RAYS[NORTH_WEST][square] & blockers);
+        int blockerIndex = bitscan_forward(MASKS.RAYS[NORTH_WEST][square] & blockers);
         // use AND to eliminate the ray past the blocker
-        attacks &= ~masks->RAYS[NORTH_WEST][blockerIndex];
+        attacks &= ~MASKS.RAYS[NORTH_WEST][blockerIndex];
     }
 
     // North East
     // OR-on the northeast ray to the attacks accumulator
-    attacks |= masks->RAYS[NORTH_EAST][square];
-    if (masks->RAYS[NORTH_EAST][square] & blockers) {
-        int blockerIndex = bitscan_forward(masks->RAYS[NORTH_EAST][square] & blockers);
-        attacks &= ~masks->RAYS[NORTH_EAST][blockerIndex];
+    attacks |= MASKS.RAYS[NORTH_EAST][square];
+    if (MASKS.RAYS[NORTH_EAST][square] & blockers) {
+        int blockerIndex = bitscan_forward(MASKS.RAYS[NORTH_EAST][square] & blockers);
+        attacks &= ~MASKS.RAYS[NORTH_EAST][blockerIndex];
     }
 
     // South East
     // OR-on the southeast ray to the attacks accumulator
-    attacks |= masks->RAYS[SOUTH_EAST][square];
-    if (masks->RAYS[SOUTH_EAST][square] & blockers) {
-        int blockerIndex = bitscan_reverse(masks->RAYS[SOUTH_EAST][square] & blockers);
-        attacks &= ~masks->RAYS[SOUTH_EAST][blockerIndex];
+    attacks |= MASKS.RAYS[SOUTH_EAST][square];
+    if (MASKS.RAYS[SOUTH_EAST][square] & blockers) {
+        int blockerIndex = bitscan_reverse(MASKS.RAYS[SOUTH_EAST][square] & blockers);
+        attacks &= ~MASKS.RAYS[SOUTH_EAST][blockerIndex];
     }
 
     // South West
     // OR-on the southwest ray to the attacks accumulator
-    attacks |= masks->RAYS[SOUTH_WEST][square];
-    if (masks->RAYS[SOUTH_WEST][square] & blockers) {
-        int blockerIndex = bitscan_reverse(masks->RAYS[SOUTH_WEST][square] & blockers);
-        attacks &= ~masks->RAYS[SOUTH_WEST][blockerIndex];
+    attacks |= MASKS.RAYS[SOUTH_WEST][square];
+    if (MASKS.RAYS[SOUTH_WEST][square] & blockers) {
+        int blockerIndex = bitscan_reverse(MASKS.RAYS[SOUTH_WEST][square] & blockers);
+        attacks &= ~MASKS.RAYS[SOUTH_WEST][blockerIndex];
     }
 
     return attacks;
@@ -84,42 +99,42 @@ auto get_bishop_moves_c(const Square square, const U64 blockers, const MaskSet*
 // 1 0 0 0 0 0 0 0
 // ^ REVERSE (left then up)
 
-auto get_rook_moves_c(const Square square, const U64 blockers, const MaskSet* masks) -> U64 {
+auto get_rook_moves_c(const Square square, const U64 blockers) -> U64 {
     U64 attacks = 0;
 
-    // North West
-    // OR-on the northwest ray to the attacks accumulator
-    attacks |= masks->RAYS[NORTH][square];
-    // if there's a blocker on the northwest ray
-    if (masks->RAYS[NORTH][square] & blockers) {
+    // North
+    // OR-on the north ray to the attacks accumulator
+    attacks |= MASKS.RAYS[NORTH][square];
+    // if there's a blocker on the north ray
+    if (MASKS.RAYS[NORTH][square] & blockers) {
         // find blocker index
-        int blockerIndex = bitscan_forward(masks->RAYS[NORTH][square] & blockers);
+        int blockerIndex = bitscan_forward(MASKS.RAYS[NORTH][square] & blockers);
         // use AND to eliminate the ray past the blocker
-        attacks &= ~masks->RAYS[NORTH][blockerIndex];
+        attacks &= ~MASKS.RAYS[NORTH][blockerIndex];
     }
 
-    // North East
-    // OR-on the northeast ray to the attacks accumulator
-    attacks |= masks->RAYS[WEST][square];
-    if (masks->RAYS[WEST][square] & blockers) {
-        int blockerIndex = bitscan_forward(masks->RAYS[WEST][square] & blockers);
-        attacks &= ~masks->RAYS[WEST][blockerIndex];
+    // East
+    // OR-on the east ray to the attacks accumulator
+    attacks |= MASKS.RAYS[EAST][square];
+    if (MASKS.RAYS[EAST][square] & blockers) {
+        int blockerIndex = bitscan_forward(MASKS.RAYS[EAST][square] & blockers);
+        attacks &= ~MASKS.RAYS[EAST][blockerIndex];
     }
 
-    // South East
-    // OR-on the southeast ray to the attacks accumulator
-    attacks |= masks->RAYS[SOUTH][square];
-    if (masks->RAYS[SOUTH][square] & blockers) {
-        int blockerIndex = bitscan_reverse(masks->RAYS[SOUTH][square] & blockers);
-        attacks &= ~masks->RAYS[SOUTH][blockerIndex];
+    // South
+    // OR-on the south ray to the attacks accumulator
+    attacks |= MASKS.RAYS[SOUTH][square];
+    if (MASKS.RAYS[SOUTH][square] & blockers) {
+        int blockerIndex = bitscan_reverse(MASKS.RAYS[SOUTH][square] & blockers);
+        attacks &= ~MASKS.RAYS[SOUTH][blockerIndex];
     }
 
-    // South West
-    // OR-on the southwest ray to the attacks accumulator
-    attacks |= masks->RAYS[EAST][square];
-    if (masks->RAYS[EAST][square] & blockers) {
-        int blockerIndex = bitscan_reverse(masks->RAYS[EAST][square] & blockers);
-        attacks &= ~masks->RAYS[EAST][blockerIndex];
+    // West
+    // OR-on the west ray to the attacks accumulator
+    attacks |= MASKS.RAYS[WEST][square];
+    if (MASKS.RAYS[WEST][square] & blockers) {
+        int blockerIndex = bitscan_reverse(MASKS.RAYS[WEST][square] & blockers);
+        attacks &= ~MASKS.RAYS[WEST][blockerIndex];
     }
 
     return attacks;
@@ -163,4 +178,40 @@ auto get_rook_moves_c(const Square square, const U64 blockers, const MaskSet* ma
 // 0 0 0 0 0 0 0 0
 // 0 0 0 0 0 0 0 0
 // 0 0 0 0 0 0 0 0
-// ^ REVERSE (left then up)
\ No newline at end of file
+// ^ REVERSE (left then up)
+
+// the slider attack functions the rest of the engine calls, routed to the build's backend.
+
+#if defined(VORPAL_SLIDERS_PEXT)
+constexpr const char* SLIDER_BACKEND = "pext";
+#elif defined(VORPAL_SLIDERS_PORTABLE)
+constexpr const char* SLIDER_BACKEND = "portable";
+#else
+constexpr const char* SLIDER_BACKEND = "magic";
+#endif
+
+auto get_bishop_moves(const Square square, const U64 blockers) -> U64 {
+    Profile::Scope scope(Profile::BISHOP_ATTACKS);
+#if defined(VORPAL_SLIDERS_PEXT)
+    return get_bishop_moves_p(square, blockers);
+#elif defined(VORPAL_SLIDERS_PORTABLE)
+    return get_bishop_moves_c(square, blockers);
+#else
+    return get_bishop_moves_m(square, blockers);
+#endif
+}
+
+auto get_rook_moves(const Square square, const U64 blockers) -> U64 {
+    Profile::Scope scope(Profile::ROOK_ATTACKS);
+#if defined(VORPAL_SLIDERS_PEXT)
+    return get_rook_moves_p(square, blockers);
+#elif defined(VORPAL_SLIDERS_PORTABLE)
+    return get_rook_moves_c(square, blockers);
+#else
+    return get_rook_moves_m(square, blockers);
+#endif
+}
+
+auto get_queen_moves(const Square square, const U64 blockers) -> U64 {
+    return get_bishop_moves(square, blockers) | get_rook_moves(square, blockers);
+}
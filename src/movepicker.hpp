@@ -0,0 +1,264 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include "move.hpp"
+#include "names.hpp"
+#include "state.hpp"
+
+// hands out a node's legal moves one at a time, best guesses first, and only generates
+// each batch of moves once the batches before it have run out. most cutoffs come from the
+// hash move or a good capture, so on cut nodes the quiet moves are never generated at all.
+//
+//   hash move -> winning and even captures, promotions (MVV-LVA)
+//             -> killers -> countermove -> quiet moves (history) -> losing captures (by SEE)
+//
+// each batch is scored into an array alongside the moves and handed out by selection, so a
+// node that cuts off after a few moves never pays for sorting the rest.
+//
+// quiescence search uses the captures-only picker, which stops after the winning captures.
+// a node in check should use the full picker, the generators only emit evasions there.
+
+enum PickerStage : uint8_t {
+    STAGE_HASH_MOVE,
+    STAGE_GEN_CAPTURES,
+    STAGE_CAPTURES,
+    STAGE_KILLERS,
+    STAGE_COUNTER_MOVE,
+    STAGE_GEN_QUIETS,
+    STAGE_QUIETS,
+    STAGE_BAD_CAPTURES,
+    STAGE_DONE
+};
+
+constexpr int NUM_KILLERS = 2;
+
+// history scores drift towards +-MAX_HISTORY as bonuses pile up, so old results fade
+// instead of the numbers growing without end
+constexpr int MAX_HISTORY = 16384;
+
+// a score for each (moved piece, target square)
+using PieceToHistory = int16_t[6][64];
+
+// what the search has learnt about quiet moves, kept per thread
+struct History {
+    // by side to move, from and to: how often the move has caused a cutoff anywhere
+    int16_t butterfly[2][64][64];
+    // by from and to of the previous move: the quiet move that last refuted it
+    Move counter_moves[64][64];
+    // by how far back (one or two plies), the colour, piece and target of that earlier move,
+    // then the piece and target of this one: how good a quiet move is as a follow-up
+    PieceToHistory continuation[2][2][6][64];
+
+    void clear() {
+        std::memset(butterfly, 0, sizeof(butterfly));
+        std::memset(continuation, 0, sizeof(continuation));
+        for (auto& from : counter_moves) {
+            for (Move& move : from) move = NULL_MOVE;
+        }
+    }
+
+    static void update(int16_t& entry, int bonus) {
+        entry += bonus - entry * std::abs(bonus) / MAX_HISTORY;
+    }
+};
+
+class MovePicker {
+    const State& state;
+    Legality legal;
+    Move hash_move;
+    Move killers[NUM_KILLERS];
+    Move counter_move = NULL_MOVE;
+    const History* history = nullptr;
+    const PieceToHistory* continuations[2] = {nullptr, nullptr};
+    MoveList moves;
+    int scores[MAX_MOVES];
+    MoveList bad_captures;
+    int index = 0;
+    int killer_index = 0;
+    int stage;
+    bool captures_only;
+
+    // most valuable victim first, least valuable attacker breaking ties.
+    // promotions score by the piece they make, on top of anything they capture.
+    void score_captures() {
+        for (int i = 0; i < moves.size(); i++) {
+            Move move = moves[i];
+            uint flags = move.get_flags();
+            Square from_square = (Square)move.get_from();
+            Square to_square = (Square)move.get_to();
+            int score = 0;
+            if (flags == EP_FLAG) {
+                score += 64 * (PAWN + 1);
+            } else if (flags & CAPTURE_FLAG) {
+                score += 64 * (state.piece_type_at(to_square) + 1);
+            }
+            if (flags & PROMOTION_FLAG) {
+                score += 64 * (State::promotion_piece(flags) + 1);
+            }
+            scores[i] = score + KING - state.piece_type_at(from_square);
+        }
+    }
+
+    // by how often the move caused cutoffs, anywhere and as a follow-up to the last two moves
+    void score_quiets() {
+        for (int i = 0; i < moves.size(); i++) {
+            Move move = moves[i];
+            Square from_square = (Square)move.get_from();
+            Square to_square = (Square)move.get_to();
+            int score = 0;
+            if (history) {
+                Piece piece = state.piece_type_at(from_square);
+                score = history->butterfly[state.turn][from_square][to_square];
+                for (const PieceToHistory* continuation : continuations) {
+                    if (continuation) score += (*continuation)[piece][to_square];
+                }
+            }
+            scores[i] = score;
+        }
+    }
+
+    // one step of a selection sort: swap the best remaining move to the front and take it
+    auto pick_best() -> Move {
+        int best = index;
+        for (int i = index + 1; i < moves.size(); i++) {
+            if (scores[i] > scores[best]) best = i;
+        }
+        std::swap(moves[index], moves[best]);
+        std::swap(scores[index], scores[best]);
+        return moves[index++];
+    }
+
+    auto is_killer(Move move) const -> bool {
+        for (Move killer : killers) {
+            if (killer == move) return true;
+        }
+        return false;
+    }
+
+    static auto is_quiet(Move move) -> bool {
+        return !move.is_capture() && !move.is_promotion();
+    }
+
+   public:
+    // for the main search, with the move from the hash table (or NULL_MOVE) and this ply's killers.
+    // quiet moves are ordered by the history tables if given, with the continuation tables of
+    // the moves one and two plies back (nullptr where there's no such move) and the countermove.
+    MovePicker(const State& s, Move hash, const Move* killer_moves, const History* hist = nullptr,
+               Move counter = NULL_MOVE, const PieceToHistory* previous = nullptr,
+               const PieceToHistory* before_previous = nullptr)
+        : state(s), legal(s.legality()), hash_move(hash), counter_move(counter), history(hist),
+          stage(STAGE_HASH_MOVE), captures_only(false) {
+        for (int i = 0; i < NUM_KILLERS; i++) killers[i] = killer_moves ? killer_moves[i] : NULL_MOVE;
+        continuations[0] = previous;
+        continuations[1] = before_previous;
+    }
+
+    // for quiescence search, captures and promotions that don't lose material only
+    MovePicker(const State& s)
+        : state(s), legal(s.legality()), hash_move(NULL_MOVE), stage(STAGE_GEN_CAPTURES), captures_only(true) {
+        for (Move& killer : killers) killer = NULL_MOVE;
+    }
+
+    // the checkers, pins etc. the picker worked out, so the search doesn't repeat the work
+    auto legality() const -> const Legality& {
+        return legal;
+    }
+
+    // writes the next move into "move", returns false once every move has been handed out
+    auto next(Move& move) -> bool {
+        switch (stage) {
+            case STAGE_HASH_MOVE:
+                stage = STAGE_GEN_CAPTURES;
+                if (!hash_move.is_null() && state.is_legal(hash_move, legal)) {
+                    move = hash_move;
+                    return true;
+                }
+                [[fallthrough]];
+
+            case STAGE_GEN_CAPTURES: {
+                MoveSink sink(moves);
+                state.generate_legal<GEN_CAPTURES>(sink, legal);
+                score_captures();
+                index = 0;
+                stage = STAGE_CAPTURES;
+            }
+                [[fallthrough]];
+
+            case STAGE_CAPTURES:
+                while (index < moves.size()) {
+                    move = pick_best();
+                    if (move == hash_move) continue;
+                    // a capture that loses material waits until after the quiet moves
+                    if (!move.is_promotion() && !state.see_ge(move, 0)) {
+                        bad_captures.push_back(move);
+                        continue;
+                    }
+                    return true;
+                }
+                if (captures_only) {
+                    stage = STAGE_DONE;
+                    return false;
+                }
+                stage = STAGE_KILLERS;
+                [[fallthrough]];
+
+            case STAGE_KILLERS:
+                while (killer_index < NUM_KILLERS) {
+                    Move killer = killers[killer_index++];
+                    // killers are quiet moves, and the same killer can't come out twice
+                    if (killer.is_null() || killer == hash_move || !is_quiet(killer)) continue;
+                    if (killer_index == 2 && killer == killers[0]) continue;
+                    if (state.is_legal(killer, legal)) {
+                        move = killer;
+                        return true;
+                    }
+                }
+                stage = STAGE_COUNTER_MOVE;
+                [[fallthrough]];
+
+            case STAGE_COUNTER_MOVE:
+                stage = STAGE_GEN_QUIETS;
+                if (!counter_move.is_null() && counter_move != hash_move && !is_killer(counter_move) &&
+                    is_quiet(counter_move) && state.is_legal(counter_move, legal)) {
+                    move = counter_move;
+                    return true;
+                }
+                [[fallthrough]];
+
+            case STAGE_GEN_QUIETS: {
+                moves.clear();
+                MoveSink sink(moves);
+                state.generate_legal<GEN_QUIETS>(sink, legal);
+                score_quiets();
+                index = 0;
+                stage = STAGE_QUIETS;
+            }
+                [[fallthrough]];
+
+            case STAGE_QUIETS:
+                while (index < moves.size()) {
+                    move = pick_best();
+                    if (move != hash_move && !is_killer(move) && move != counter_move) return true;
+                }
+                index = 0;
+                stage = STAGE_BAD_CAPTURES;
+                [[fallthrough]];
+
+            case STAGE_BAD_CAPTURES:
+                // already in MVV-LVA order
+                if (index < bad_captures.size()) {
+                    move = bad_captures[index++];
+                    return true;
+                }
+                stage = STAGE_DONE;
+                [[fallthrough]];
+
+            default:
+                return false;
+        }
+    }
+};
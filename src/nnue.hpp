@@ -0,0 +1,302 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "names.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+using U64 = unsigned long long;
+
+// an efficiently updatable neural network evaluation.
+//
+//   768 inputs (colour, piece, square) -> HIDDEN, once from each side's point of view
+//   -> clipped ReLU -> [side to move, other side] -> 1 output
+//
+// the first layer is one int16 column per input, and a position's hidden layer (the
+// accumulator) is the bias plus the columns of the pieces on the board. a move only touches
+// two or three pieces, so State keeps the accumulator as it goes, adding and subtracting
+// columns in the same add/remove/move primitives that keep the keys. taking a move back
+// subtracts what was added, so the accumulator needs no stack.
+//
+// the network is loaded from a file; with none loaded the engine uses the handcrafted
+// evaluation and the primitives skip the accumulator altogether.
+//
+// file format, little-endian:
+//   "VNN1", uint32 hidden size,
+//   int16 feature_weights[768][HIDDEN], int16 feature_bias[HIDDEN],
+//   int16 output_weights[2 * HIDDEN], int32 output_bias
+
+namespace Nnue {
+constexpr int INPUTS = 768;
+constexpr int HIDDEN = 256;
+// quantisation: the hidden layer is clipped to [0, QA], output weights are scaled by QB,
+// and the output is scaled to centipawns by SCALE
+constexpr int QA = 255;
+constexpr int QB = 64;
+constexpr int SCALE = 400;
+
+#if defined(__AVX2__)
+constexpr const char* SIMD_NAME = "avx2";
+#elif defined(__SSE2__)
+constexpr const char* SIMD_NAME = "sse2";
+#elif defined(__ARM_NEON)
+constexpr const char* SIMD_NAME = "neon";
+#else
+constexpr const char* SIMD_NAME = "scalar";
+#endif
+
+struct alignas(64) Network {
+    int16_t feature_weights[INPUTS][HIDDEN];
+    int16_t feature_bias[HIDDEN];
+    int16_t output_weights[2 * HIDDEN];
+    int32_t output_bias;
+};
+
+Network NETWORK;
+bool ACTIVE = false;
+
+// one hidden layer per point of view, indexed by colour
+struct alignas(64) Accumulator {
+    int16_t values[2][HIDDEN];
+};
+
+// a piece's input from one side's point of view: the side's own pieces come first, and
+// black sees the board flipped, so both sides see their pieces the same way
+constexpr auto feature(Colour perspective, Colour colour, int piece, int square) -> int {
+    return (colour != perspective) * 384 + piece * 64 + (perspective == WHITE ? square : square ^ 56);
+}
+
+/////////////////////////////// KERNELS ///////////////////////////////
+
+// acc += column
+void add_column(int16_t* acc, const int16_t* column) {
+#if defined(__AVX2__)
+    for (int i = 0; i < HIDDEN; i += 16) {
+        __m256i a = _mm256_load_si256((const __m256i*)(acc + i));
+        __m256i w = _mm256_load_si256((const __m256i*)(column + i));
+        _mm256_store_si256((__m256i*)(acc + i), _mm256_add_epi16(a, w));
+    }
+#elif defined(__SSE2__)
+    for (int i = 0; i < HIDDEN; i += 8) {
+        __m128i a = _mm_load_si128((const __m128i*)(acc + i));
+        __m128i w = _mm_load_si128((const __m128i*)(column + i));
+        _mm_store_si128((__m128i*)(acc + i), _mm_add_epi16(a, w));
+    }
+#elif defined(__ARM_NEON)
+    for (int i = 0; i < HIDDEN; i += 8) {
+        vst1q_s16(acc + i, vaddq_s16(vld1q_s16(acc + i), vld1q_s16(column + i)));
+    }
+#else
+    for (int i = 0; i < HIDDEN; i++) acc[i] += column[i];
+#endif
+}
+
+// acc -= column
+void sub_column(int16_t* acc, const int16_t* column) {
+#if defined(__AVX2__)
+    for (int i = 0; i < HIDDEN; i += 16) {
+        __m256i a = _mm256_load_si256((const __m256i*)(acc + i));
+        __m256i w = _mm256_load_si256((const __m256i*)(column + i));
+        _mm256_store_si256((__m256i*)(acc + i), _mm256_sub_epi16(a, w));
+    }
+#elif defined(__SSE2__)
+    for (int i = 0; i < HIDDEN; i += 8) {
+        __m128i a = _mm_load_si128((const __m128i*)(acc + i));
+        __m128i w = _mm_load_si128((const __m128i*)(column + i));
+        _mm_store_si128((__m128i*)(acc + i), _mm_sub_epi16(a, w));
+    }
+#elif defined(__ARM_NEON)
+    for (int i = 0; i < HIDDEN; i += 8) {
+        vst1q_s16(acc + i, vsubq_s16(vld1q_s16(acc + i), vld1q_s16(column + i)));
+    }
+#else
+    for (int i = 0; i < HIDDEN; i++) acc[i] -= column[i];
+#endif
+}
+
+// acc += added - removed, a piece moving in one pass over the accumulator
+void add_sub_column(int16_t* acc, const int16_t* added, const int16_t* removed) {
+#if defined(__AVX2__)
+    for (int i = 0; i < HIDDEN; i += 16) {
+        __m256i a = _mm256_load_si256((const __m256i*)(acc + i));
+        __m256i w_add = _mm256_load_si256((const __m256i*)(added + i));
+        __m256i w_sub = _mm256_load_si256((const __m256i*)(removed + i));
+        _mm256_store_si256((__m256i*)(acc + i), _mm256_sub_epi16(_mm256_add_epi16(a, w_add), w_sub));
+    }
+#elif defined(__SSE2__)
+    for (int i = 0; i < HIDDEN; i += 8) {
+        __m128i a = _mm_load_si128((const __m128i*)(acc + i));
+        __m128i w_add = _mm_load_si128((const __m128i*)(added + i));
+        __m128i w_sub = _mm_load_si128((const __m128i*)(removed + i));
+        _mm_store_si128((__m128i*)(acc + i), _mm_sub_epi16(_mm_add_epi16(a, w_add), w_sub));
+    }
+#elif defined(__ARM_NEON)
+    for (int i = 0; i < HIDDEN; i += 8) {
+        int16x8_t a = vaddq_s16(vld1q_s16(acc + i), vld1q_s16(added + i));
+        vst1q_s16(acc + i, vsubq_s16(a, vld1q_s16(removed + i)));
+    }
+#else
+    for (int i = 0; i < HIDDEN; i++) acc[i] += added[i] - removed[i];
+#endif
+}
+
+// sum of clamp(acc, 0, QA) * weights, in int32
+auto crelu_dot(const int16_t* acc, const int16_t* weights) -> int32_t {
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i qa = _mm256_set1_epi16(QA);
+    __m256i sum = _mm256_setzero_si256();
+    for (int i = 0; i < HIDDEN; i += 16) {
+        __m256i a = _mm256_load_si256((const __m256i*)(acc + i));
+        a = _mm256_min_epi16(_mm256_max_epi16(a, zero), qa);
+        __m256i w = _mm256_load_si256((const __m256i*)(weights + i));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a, w));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0b01001110));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0b10110001));
+    return _mm_cvtsi128_si32(half);
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i qa = _mm_set1_epi16(QA);
+    __m128i sum = _mm_setzero_si128();
+    for (int i = 0; i < HIDDEN; i += 8) {
+        __m128i a = _mm_load_si128((const __m128i*)(acc + i));
+        a = _mm_min_epi16(_mm_max_epi16(a, zero), qa);
+        __m128i w = _mm_load_si128((const __m128i*)(weights + i));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(a, w));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0b01001110));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0b10110001));
+    return _mm_cvtsi128_si32(sum);
+#elif defined(__ARM_NEON)
+    const int16x8_t zero = vdupq_n_s16(0);
+    const int16x8_t qa = vdupq_n_s16(QA);
+    int32x4_t sum = vdupq_n_s32(0);
+    for (int i = 0; i < HIDDEN; i += 8) {
+        int16x8_t a = vminq_s16(vmaxq_s16(vld1q_s16(acc + i), zero), qa);
+        int16x8_t w = vld1q_s16(weights + i);
+        sum = vmlal_s16(sum, vget_low_s16(a), vget_low_s16(w));
+        sum = vmlal_s16(sum, vget_high_s16(a), vget_high_s16(w));
+    }
+    return vaddvq_s32(sum);
+#else
+    int32_t sum = 0;
+    for (int i = 0; i < HIDDEN; i++) {
+        int32_t a = acc[i] < 0 ? 0 : acc[i] > QA ? QA : acc[i];
+        sum += a * weights[i];
+    }
+    return sum;
+#endif
+}
+
+/////////////////////////// ACCUMULATOR UPDATES ///////////////////////////
+
+void add_piece(Accumulator& acc, Colour colour, int piece, int square) {
+    for (Colour perspective : {WHITE, BLACK}) {
+        add_column(acc.values[perspective], NETWORK.feature_weights[feature(perspective, colour, piece, square)]);
+    }
+}
+
+void remove_piece(Accumulator& acc, Colour colour, int piece, int square) {
+    for (Colour perspective : {WHITE, BLACK}) {
+        sub_column(acc.values[perspective], NETWORK.feature_weights[feature(perspective, colour, piece, square)]);
+    }
+}
+
+void move_piece(Accumulator& acc, Colour colour, int piece, int from, int to) {
+    for (Colour perspective : {WHITE, BLACK}) {
+        add_sub_column(acc.values[perspective],
+                       NETWORK.feature_weights[feature(perspective, colour, piece, to)],
+                       NETWORK.feature_weights[feature(perspective, colour, piece, from)]);
+    }
+}
+
+// the accumulator from scratch: the bias plus every piece on the board
+void refresh(Accumulator& acc, const U64 occupied_co[2], const U64 pieces[6]) {
+    std::memcpy(acc.values[WHITE], NETWORK.feature_bias, sizeof(NETWORK.feature_bias));
+    std::memcpy(acc.values[BLACK], NETWORK.feature_bias, sizeof(NETWORK.feature_bias));
+    for (int piece = PAWN; piece <= KING; piece++) {
+        for (Colour colour : {WHITE, BLACK}) {
+            for (U64 bb = pieces[piece] & occupied_co[colour]; bb; bb &= bb - 1) {
+                add_piece(acc, colour, piece, __builtin_ctzll(bb));
+            }
+        }
+    }
+}
+
+// centipawns for the side to move
+auto evaluate(const Accumulator& acc, Colour turn) -> int {
+    int32_t output = crelu_dot(acc.values[turn], NETWORK.output_weights) +
+                     crelu_dot(acc.values[!turn], NETWORK.output_weights + HIDDEN) +
+                     NETWORK.output_bias;
+    return (int)((int64_t)output * SCALE / (QA * QB));
+}
+
+///////////////////////////////// LOADING /////////////////////////////////
+
+// reads a network file, and switches the engine over to it if it's good. the file is read
+// into a network of its own first, so a short or corrupt file leaves whatever network was
+// in use (or the handcrafted evaluation) untouched.
+// States set up before this need State::refresh_accumulator().
+auto load(const std::string& path) -> bool {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    char magic[4];
+    uint32_t hidden = 0;
+    file.read(magic, 4);
+    file.read((char*)&hidden, sizeof(hidden));
+    if (!file || std::memcmp(magic, "VNN1", 4) != 0 || hidden != HIDDEN) return false;
+    auto network = std::make_unique<Network>();
+    file.read((char*)network->feature_weights, sizeof(network->feature_weights));
+    file.read((char*)network->feature_bias, sizeof(network->feature_bias));
+    file.read((char*)network->output_weights, sizeof(network->output_weights));
+    file.read((char*)&network->output_bias, sizeof(network->output_bias));
+    // all of it there, and nothing after it
+    if (!file || file.peek() != std::char_traits<char>::eof()) return false;
+    NETWORK = *network;
+    ACTIVE = true;
+    return true;
+}
+
+auto save(const std::string& path) -> bool {
+    std::ofstream file(path, std::ios::binary);
+    uint32_t hidden = HIDDEN;
+    file.write("VNN1", 4);
+    file.write((const char*)&hidden, sizeof(hidden));
+    file.write((const char*)NETWORK.feature_weights, sizeof(NETWORK.feature_weights));
+    file.write((const char*)NETWORK.feature_bias, sizeof(NETWORK.feature_bias));
+    file.write((const char*)NETWORK.output_weights, sizeof(NETWORK.output_weights));
+    file.write((const char*)&NETWORK.output_bias, sizeof(NETWORK.output_bias));
+    return (bool)file;
+}
+
+// fills the network with small random weights and switches to it. the evaluations are
+// noise, but it exercises exactly the same code, for benchmarking without a trained net.
+void randomise(U64 seed) {
+    auto next = [&seed]() {
+        seed ^= seed >> 12;
+        seed ^= seed << 25;
+        seed ^= seed >> 27;
+        return seed * 2685821657736338717ULL;
+    };
+    for (auto& column : NETWORK.feature_weights) {
+        for (int16_t& w : column) w = (int16_t)((int)(next() % 33) - 16);
+    }
+    for (int16_t& b : NETWORK.feature_bias) b = (int16_t)(next() % 64);
+    for (int16_t& w : NETWORK.output_weights) w = (int16_t)((int)(next() % 129) - 64);
+    NETWORK.output_bias = 0;
+    ACTIVE = true;
+}
+};  // namespace Nnue
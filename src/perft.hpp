@@ -0,0 +1,157 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "move.hpp"
+#include "state.hpp"
+#include "vorpal_helpers.hpp"
+
+using U64 = unsigned long long;
+
+// perft walks the legal move tree to a fixed depth and counts the leaves.
+// the counts for the standard test positions are well known, so any mismatch is a
+// move generation (or make/unmake) bug, and the leaves per second are a clean measure
+// of generator throughput.
+
+namespace Perft {
+struct Position {
+    std::string name;
+    std::string fen;
+    // node counts from depth 1 upwards
+    std::vector<U64> nodes;
+};
+
+// the positions from the chessprogramming wiki perft results page
+const std::vector<Position> SUITE = {
+    {"startpos", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+     {20ULL, 400ULL, 8902ULL, 197281ULL, 4865609ULL, 119060324ULL}},
+    {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+     {48ULL, 2039ULL, 97862ULL, 4085603ULL, 193690690ULL}},
+    {"position 3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+     {14ULL, 191ULL, 2812ULL, 43238ULL, 674624ULL, 11030083ULL}},
+    {"position 4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+     {6ULL, 264ULL, 9467ULL, 422333ULL, 15833292ULL}},
+    {"position 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+     {44ULL, 1486ULL, 62379ULL, 2103487ULL, 89941194ULL}},
+    {"position 6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+     {46ULL, 2079ULL, 89890ULL, 3894594ULL, 164075551ULL}},
+};
+
+// positions reached by playing moves from the start, with their FENs. loading the FEN has
+// to give the same key as playing the moves, or the two would be apart in the hash table.
+// a FEN names the ep square after any double push, the key only counts it when it can be taken.
+struct KeyCheck {
+    std::vector<std::string> moves;
+    std::string fen;
+};
+
+const std::vector<KeyCheck> KEY_CHECKS = {
+    {{"e2e4"}, "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1"},
+    {{"e2e4", "a7a6", "e4e5", "d7d5"}, "rnbqkbnr/1pp1pppp/p7/3pP3/8/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 3"},
+    {{"g1f3", "g8f6", "f3g1", "f6g8"}, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 4 3"},
+};
+
+// with bulk counting the last ply is counted by the generator instead of
+// being played out, which is how perft is usually quoted.
+// the side to move is a template parameter all the way down, so each node calls straight
+// into its colour's generator and make/unmake without going through the dispatch.
+template <Colour US>
+auto perft(State& state, int depth, bool bulk) -> U64 {
+    if (depth == 0) return 1;
+    const Legality legal = state.legality<US>();
+    if (bulk && depth == 1) {
+        CountSink sink;
+        state.generate_legal_for<US, GEN_ALL>(sink, legal);
+        return sink.count;
+    }
+
+    MoveList moves;
+    MoveSink sink(moves);
+    state.generate_legal_for<US, GEN_ALL>(sink, legal);
+    U64 nodes = 0;
+    for (Move move : moves) {
+        state.push<US>(move);
+        nodes += perft<!US>(state, depth - 1, bulk);
+        state.pop<US>(move);
+    }
+    return nodes;
+}
+
+auto perft(State& state, int depth, bool bulk = true) -> U64 {
+    return state.turn == WHITE ? perft<WHITE>(state, depth, bulk) : perft<BLACK>(state, depth, bulk);
+}
+
+auto seconds_since(std::chrono::steady_clock::time_point start) -> double {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// perft split by root move, for bisecting a wrong count against another engine
+auto divide(State& state, int depth, bool bulk = true) -> U64 {
+    auto start = std::chrono::steady_clock::now();
+    U64 total = 0;
+    for (Move move : state.legal_moves()) {
+        state.push(move);
+        U64 nodes = perft(state, depth - 1, bulk);
+        state.pop(move);
+        std::cout << move_notation(move) << ": " << nodes << "\n";
+        total += nodes;
+    }
+    double elapsed = seconds_since(start);
+    std::cout << "\nnodes " << total << " time " << elapsed << "s nps " << (U64)(total / elapsed) << "\n";
+    return total;
+}
+
+// whether every KEY_CHECKS position keys the same loaded as played
+auto check_keys() -> bool {
+    bool all_passed = true;
+    for (const KeyCheck& check : KEY_CHECKS) {
+        State played;
+        for (const std::string& text : check.moves) {
+            for (Move move : played.legal_moves()) {
+                if (move_notation(move) == text) {
+                    played.push(move);
+                    break;
+                }
+            }
+        }
+        State loaded;
+        bool passed = loaded.load_fen(check.fen) && loaded.key == played.key && loaded.fen() == played.fen();
+        all_passed &= passed;
+        if (!passed) std::cout << "key mismatch: " << played.fen() << " played, " << check.fen << " loaded\n";
+    }
+    return all_passed;
+}
+
+// runs every suite position up to max_depth (or as deep as its known counts go) and the
+// key checks, returns whether every count and key matched.
+auto run_suite(int max_depth, bool bulk = true) -> bool {
+    bool all_passed = true;
+    U64 total_nodes = 0;
+    double total_time = 0;
+    for (const Position& position : SUITE) {
+        State state;
+        state.load_fen(position.fen);
+        int depth_limit = std::min(max_depth, (int)position.nodes.size());
+        for (int depth = 1; depth <= depth_limit; depth++) {
+            auto start = std::chrono::steady_clock::now();
+            U64 nodes = perft(state, depth, bulk);
+            double elapsed = seconds_since(start);
+            bool passed = nodes == position.nodes[depth - 1];
+            all_passed &= passed;
+            total_nodes += nodes;
+            total_time += elapsed;
+            std::cout << position.name << " depth " << depth << ": " << nodes
+                      << (passed ? " ok" : " FAILED, expected " + std::to_string(position.nodes[depth - 1]))
+                      << " (" << elapsed << "s, " << (U64)(nodes / std::max(elapsed, 1e-9)) << " nps)\n";
+        }
+    }
+    all_passed &= check_keys();
+    std::cout << "\n"
+              << (all_passed ? "all counts correct" : "SOME COUNTS OR KEYS WRONG") << ", " << total_nodes << " nodes in "
+              << total_time << "s, " << (U64)(total_nodes / std::max(total_time, 1e-9)) << " nps\n";
+    return all_passed;
+}
+};  // namespace Perft
@@ -0,0 +1,128 @@
+#pragma once
+
+// PEXT-indexed slider attack tables, for CPUs with BMI2.
+// the relevant blockers are gathered into a dense index with a single _pext_u64,
+// so unlike the magics there is no multiply and no per-square magic constant to load.
+// only compiled in when the build selects this backend (see movegen.hpp).
+
+#if !defined(__BMI2__)
+#error "the PEXT slider backend needs BMI2, build with -mbmi2 (or -march=native on a BMI2 machine)"
+#endif
+
+#include <immintrin.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "intrinsic_functions.hpp"
+#include "magic.hpp"
+#include "names.hpp"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+using U64 = unsigned long long;
+
+// the CPU check has to run before anything else, and must not itself contain an instruction
+// the CPU might not have: with -mbmi2 the compiler is free to use shlx/shrx in any code,
+// the table building below and in magic.hpp included. so on GCC and Clang it's a constructor
+// of the highest priority, compiled for plain x86-64. iostreams aren't set up that early,
+// which is why it writes with stdio.
+#if defined(_MSC_VER)
+#define VORPAL_NO_BMI2
+#define VORPAL_BEFORE_STATICS
+#else
+#define VORPAL_NO_BMI2 __attribute__((target("no-bmi2")))
+#define VORPAL_BEFORE_STATICS __attribute__((constructor(101)))
+#endif
+
+namespace Pext {
+// CPUID leaf 7, subleaf 0, EBX bit 8 reports BMI2
+VORPAL_NO_BMI2 auto cpu_has_bmi2() -> bool {
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuidex(regs, 7, 0);
+    return regs[1] & (1 << 8);
+#else
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+    return ebx & (1 << 8);
+#endif
+}
+
+// runs before the static initialisers, so an unsupported CPU gets an error instead of SIGILL
+VORPAL_NO_BMI2 VORPAL_BEFORE_STATICS void require_bmi2() {
+    if (!cpu_has_bmi2()) {
+        std::fputs("this build of Vorpal uses the PEXT slider backend, but this CPU has no BMI2 support.\n"
+                   "rebuild without -DVORPAL_SLIDERS_PEXT to use the magic bitboard backend.\n",
+                   stderr);
+        std::exit(1);
+    }
+}
+
+#if defined(_MSC_VER)
+// MSVC has no constructor priorities and won't emit BMI2 code on its own, so an ordinary
+// static initialiser ahead of the tables is enough there
+const bool BMI2_CHECKED = (require_bmi2(), true);
+#endif
+
+struct Entry {
+    U64 mask;
+    U64* attacks;
+
+    auto index(U64 blockers) const -> unsigned {
+        return (unsigned)_pext_u64(blockers, mask);
+    }
+};
+
+class Tables {
+   public:
+    Entry bishops[64];
+    Entry rooks[64];
+    U64 bishop_attacks[Magic::BISHOP_TABLE_SIZE];
+    U64 rook_attacks[Magic::ROOK_TABLE_SIZE];
+
+    Tables() {
+        fill(bishops, bishop_attacks, Magic::BISHOP_DELTAS);
+        fill(rooks, rook_attacks, Magic::ROOK_DELTAS);
+    }
+
+   private:
+    static void fill(Entry entries[64], U64* table, const int deltas[4][2]) {
+        U64* next = table;
+        for (int square = 0; square < 64; square++) {
+            Entry& e = entries[square];
+            e.mask = Magic::relevant_blockers(square, deltas);
+            e.attacks = next;
+            // the carry-rippler visits the subsets of the mask in the same order as
+            // their pext indices count up, so the table can be filled without executing pext.
+            U64 blockers = 0;
+            unsigned index = 0;
+            do {
+                e.attacks[index++] = Magic::sliding_attacks(square, blockers, deltas);
+                blockers = (blockers - e.mask) & e.mask;
+            } while (blockers);
+            next += index;
+        }
+    }
+};
+
+const Tables TABLES;
+};  // namespace Pext
+
+auto get_bishop_moves_p(const Square square, const U64 blockers) -> U64 {
+    const Pext::Entry& e = Pext::TABLES.bishops[square];
+    return e.attacks[e.index(blockers)];
+}
+
+auto get_rook_moves_p(const Square square, const U64 blockers) -> U64 {
+    const Pext::Entry& e = Pext::TABLES.rooks[square];
+    return e.attacks[e.index(blockers)];
+}
+
+auto get_queen_moves_p(const Square square, const U64 blockers) -> U64 {
+    return get_bishop_moves_p(square, blockers) | get_rook_moves_p(square, blockers);
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+#include "names.hpp"
+
+// hot-path instrumentation, built in with -DVORPAL_PROFILE and compiled away entirely otherwise.
+//
+// a Profile::Scope at the top of a function counts the call and the cycles (rdtsc, or
+// nanoseconds off x86) until it returns. the counts are inclusive: is_check's cycles
+// contain those of the slider lookups it makes. timing a call this short costs about as
+// much as the call itself, so the numbers are for comparing the hot paths with each other,
+// not for nodes per second. every thread counts into its own block, and the blocks are
+// added up when the counts are read.
+//
+// the search's own statistics (SearchStats) are only kept in a profiling build too.
+
+namespace Profile {
+#if defined(VORPAL_PROFILE)
+constexpr bool ENABLED = true;
+#else
+constexpr bool ENABLED = false;
+#endif
+
+enum Counter : uint8_t {
+    GEN_PAWN_PUSHES,
+    GEN_PAWN_CAPTURES,
+    GEN_KNIGHT_MOVES,
+    GEN_KING_MOVES,
+    GEN_BISHOP_MOVES,
+    GEN_ROOK_MOVES,
+    GEN_QUEEN_MOVES,
+    BISHOP_ATTACKS,
+    ROOK_ATTACKS,
+    IS_CHECK,
+    PUSH,
+    POP,
+    EVALUATE,
+    NUM_COUNTERS
+};
+
+constexpr const char* COUNTER_NAMES[NUM_COUNTERS] = {
+    "add_pawn_pushes", "add_pawn_captures", "add_knight_moves", "add_king_moves", "add_bishop_moves",
+    "add_rook_moves", "add_queen_moves", "get_bishop_moves", "get_rook_moves", "is_check",
+    "push", "pop", "evaluate"};
+
+struct Counts {
+    U64 calls[NUM_COUNTERS] = {};
+    U64 cycles[NUM_COUNTERS] = {};
+};
+
+// owns every thread's counts, so they outlive the threads that made them
+class Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Counts>> blocks;
+
+   public:
+    auto add() -> Counts* {
+        std::lock_guard<std::mutex> lock(mutex);
+        blocks.push_back(std::make_unique<Counts>());
+        return blocks.back().get();
+    }
+
+    auto total() -> Counts {
+        std::lock_guard<std::mutex> lock(mutex);
+        Counts sum;
+        for (const auto& block : blocks) {
+            for (int i = 0; i < NUM_COUNTERS; i++) {
+                sum.calls[i] += block->calls[i];
+                sum.cycles[i] += block->cycles[i];
+            }
+        }
+        return sum;
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& block : blocks) *block = Counts();
+    }
+};
+
+Registry REGISTRY;
+
+auto local_counts() -> Counts& {
+    thread_local Counts* counts = REGISTRY.add();
+    return *counts;
+}
+
+inline auto cycles() -> U64 {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (U64)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// counts the enclosing function, an empty object in a normal build
+class Scope {
+    [[maybe_unused]] Counter counter;
+    [[maybe_unused]] U64 start = 0;
+
+   public:
+    explicit Scope(Counter c) : counter(c) {
+        if constexpr (ENABLED) start = cycles();
+    }
+
+    ~Scope() {
+        if constexpr (ENABLED) {
+            Counts& counts = local_counts();
+            counts.calls[counter]++;
+            counts.cycles[counter] += cycles() - start;
+        }
+    }
+};
+
+// what the search did, per thread and summed over them
+struct SearchStats {
+    U64 nodes = 0;
+    U64 qnodes = 0;  // of which in quiescence search
+    U64 tt_probes = 0;
+    U64 tt_hits = 0;
+    U64 cutoffs = 0;  // beta cutoffs with at least one move searched
+    U64 first_move_cutoffs = 0;
+    U64 null_tries = 0;
+    U64 null_cutoffs = 0;
+    U64 lmr_tries = 0;     // reduced searches
+    U64 lmr_research = 0;  // of which beat alpha and had to be searched again at full depth
+
+    void operator+=(const SearchStats& other) {
+        nodes += other.nodes;
+        qnodes += other.qnodes;
+        tt_probes += other.tt_probes;
+        tt_hits += other.tt_hits;
+        cutoffs += other.cutoffs;
+        first_move_cutoffs += other.first_move_cutoffs;
+        null_tries += other.null_tries;
+        null_cutoffs += other.null_cutoffs;
+        lmr_tries += other.lmr_tries;
+        lmr_research += other.lmr_research;
+    }
+};
+
+inline auto rate(U64 part, U64 whole) -> double {
+    return whole ? (double)part / (double)whole : 0.0;
+}
+
+// the counters and the search statistics as one JSON object
+void write_json(std::ostream& out, const SearchStats& stats) {
+    Counts counts = REGISTRY.total();
+    out << "{\"enabled\": " << (ENABLED ? "true" : "false") << ", \"functions\": {";
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        out << (i ? ", " : "") << "\"" << COUNTER_NAMES[i] << "\": {\"calls\": " << counts.calls[i]
+            << ", \"cycles\": " << counts.cycles[i]
+            << ", \"cycles_per_call\": " << rate(counts.cycles[i], counts.calls[i]) << "}";
+    }
+    out << "}, \"search\": {"
+        << "\"nodes\": " << stats.nodes << ", \"qnodes\": " << stats.qnodes
+        << ", \"qsearch_share\": " << rate(stats.qnodes, stats.nodes)
+        << ", \"tt_probes\": " << stats.tt_probes << ", \"tt_hits\": " << stats.tt_hits
+        << ", \"tt_hit_rate\": " << rate(stats.tt_hits, stats.tt_probes)
+        << ", \"cutoffs\": " << stats.cutoffs << ", \"first_move_cutoffs\": " << stats.first_move_cutoffs
+        << ", \"first_move_cutoff_rate\": " << rate(stats.first_move_cutoffs, stats.cutoffs)
+        << ", \"null_tries\": " << stats.null_tries << ", \"null_cutoffs\": " << stats.null_cutoffs
+        << ", \"null_success_rate\": " << rate(stats.null_cutoffs, stats.null_tries)
+        << ", \"lmr_tries\": " << stats.lmr_tries << ", \"lmr_research\": " << stats.lmr_research
+        << ", \"lmr_success_rate\": " << rate(stats.lmr_tries - stats.lmr_research, stats.lmr_tries) << "}}\n";
+}
+};  // namespace Profile
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstdint>
+
+#include "names.hpp"
+
+// the material and piece-square part of the evaluation, which State keeps up to date
+// as pieces come and go (see add_piece etc.) rather than rescanning the board at every leaf.
+//
+// every term has a midgame and an endgame value, packed into one int so that a single
+// addition updates both: the endgame value sits in the high 16 bits, the midgame value in
+// the low 16. evaluation blends the two by the game phase.
+
+using Score = int;
+
+constexpr auto S(int mg, int eg) -> Score {
+    return (Score)((unsigned)eg << 16) + mg;
+}
+
+constexpr auto mg_value(Score s) -> int {
+    return (int16_t)(uint16_t)(unsigned)s;
+}
+
+// the +0x8000 undoes the borrow a negative midgame value takes from the endgame half
+constexpr auto eg_value(Score s) -> int {
+    return (int16_t)(uint16_t)((unsigned)(s + 0x8000) >> 16);
+}
+
+namespace Psqt {
+constexpr Score MATERIAL[6] = {S(100, 120), S(320, 300), S(330, 320), S(500, 540), S(900, 950), S(0, 0)};
+
+// how much each piece counts towards the midgame, the full board adds up to PHASE_TOTAL
+constexpr int PHASE_WEIGHT[6] = {0, 1, 1, 2, 4, 0};
+constexpr int PHASE_TOTAL = 24;
+
+// tables are laid out as white sees the board, eighth rank first, so a white piece on
+// square sq reads entry sq ^ 56 and a black piece reads entry sq directly.
+// the shapes follow Michniewski's "simplified evaluation function", with endgame tables
+// for the pawns (push them) and the king (centralise it).
+
+constexpr int PAWN_MG[64] = {
+     0,   0,   0,   0,   0,   0,   0,   0,
+    50,  50,  50,  50,  50,  50,  50,  50,
+    10,  10,  20,  30,  30,  20,  10,  10,
+     5,   5,  10,  25,  25,  10,   5,   5,
+     0,   0,   0,  20,  20,   0,   0,   0,
+     5,  -5, -10,   0,   0, -10,  -5,   5,
+     5,  10,  10, -20, -20,  10,  10,   5,
+     0,   0,   0,   0,   0,   0,   0,   0};
+
+constexpr int PAWN_EG[64] = {
+     0,   0,   0,   0,   0,   0,   0,   0,
+    80,  80,  80,  80,  80,  80,  80,  80,
+    50,  50,  50,  50,  50,  50,  50,  50,
+    30,  30,  30,  30,  30,  30,  30,  30,
+    15,  15,  15,  15,  15,  15,  15,  15,
+     5,   5,   5,   5,   5,   5,   5,   5,
+     0,   0,   0,   0,   0,   0,   0,   0,
+     0,   0,   0,   0,   0,   0,   0,   0};
+
+constexpr int KNIGHT_TABLE[64] = {
+    -50, -40, -30, -30, -30, -30, -40, -50,
+    -40, -20,   0,   0,   0,   0, -20, -40,
+    -30,   0,  10,  15,  15,  10,   0, -30,
+    -30,   5,  15,  20,  20,  15,   5, -30,
+    -30,   0,  15,  20,  20,  15,   0, -30,
+    -30,   5,  10,  15,  15,  10,   5, -30,
+    -40, -20,   0,   5,   5,   0, -20, -40,
+    -50, -40, -30, -30, -30, -30, -40, -50};
+
+constexpr int BISHOP_TABLE[64] = {
+    -20, -10, -10, -10, -10, -10, -10, -20,
+    -10,   0,   0,   0,   0,   0,   0, -10,
+    -10,   0,   5,  10,  10,   5,   0, -10,
+    -10,   5,   5,  10,  10,   5,   5, -10,
+    -10,   0,  10,  10,  10,  10,   0, -10,
+    -10,  10,  10,  10,  10,  10,  10, -10,
+    -10,   5,   0,   0,   0,   0,   5, -10,
+    -20, -10, -10, -10, -10, -10, -10, -20};
+
+constexpr int ROOK_TABLE[64] = {
+     0,   0,   0,   0,   0,   0,   0,   0,
+     5,  10,  10,  10,  10,  10,  10,   5,
+    -5,   0,   0,   0,   0,   0,   0,  -5,
+    -5,   0,   0,   0,   0,   0,   0,  -5,
+    -5,   0,   0,   0,   0,   0,   0,  -5,
+    -5,   0,   0,   0,   0,   0,   0,  -5,
+    -5,   0,   0,   0,   0,   0,   0,  -5,
+     0,   0,   0,   5,   5,   0,   0,   0};
+
+constexpr int QUEEN_TABLE[64] = {
+    -20, -10, -10,  -5,  -5, -10, -10, -20,
+    -10,   0,   0,   0,   0,   0,   0, -10,
+    -10,   0,   5,   5,   5,   5,   0, -10,
+     -5,   0,   5,   5,   5,   5,   0,  -5,
+      0,   0,   5,   5,   5,   5,   0,  -5,
+    -10,   5,   5,   5,   5,   5,   0, -10,
+    -10,   0,   5,   0,   0,   0,   0, -10,
+    -20, -10, -10,  -5,  -5, -10, -10, -20};
+
+constexpr int KING_MG[64] = {
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -20, -30, -30, -40, -40, -30, -30, -20,
+    -10, -20, -20, -20, -20, -20, -20, -10,
+     20,  20,   0,   0,   0,   0,  20,  20,
+     20,  30,  10,   0,   0,  10,  30,  20};
+
+constexpr int KING_EG[64] = {
+    -50, -40, -30, -20, -20, -30, -40, -50,
+    -30, -20, -10,   0,   0, -10, -20, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -30,   0,   0,   0,   0, -30, -30,
+    -50, -30, -30, -30, -30, -30, -30, -50};
+
+constexpr const int* MG_TABLES[6] = {PAWN_MG, KNIGHT_TABLE, BISHOP_TABLE, ROOK_TABLE, QUEEN_TABLE, KING_MG};
+constexpr const int* EG_TABLES[6] = {PAWN_EG, KNIGHT_TABLE, BISHOP_TABLE, ROOK_TABLE, QUEEN_TABLE, KING_EG};
+
+// material plus square for every (colour, piece, square), from white's point of view
+struct Table {
+    Score values[2][6][64];
+};
+
+constexpr auto generate() -> Table {
+    Table table{};
+    for (int piece = PAWN; piece <= KING; piece++) {
+        for (int square = 0; square < 64; square++) {
+            Score white = MATERIAL[piece] + S(MG_TABLES[piece][square ^ 56], EG_TABLES[piece][square ^ 56]);
+            Score black = MATERIAL[piece] + S(MG_TABLES[piece][square], EG_TABLES[piece][square]);
+            table.values[WHITE][piece][square] = white;
+            table.values[BLACK][piece][square] = -black;
+        }
+    }
+    return table;
+}
+
+constexpr Table TABLE = generate();
+
+constexpr auto value(Colour colour, Piece piece, int square) -> Score {
+    return TABLE.values[colour][piece][square];
+}
+};  // namespace Psqt
@@ -0,0 +1,434 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+#include "eval.hpp"
+#include "move.hpp"
+#include "movepicker.hpp"
+#include "profile.hpp"
+#include "state.hpp"
+#include "tablebase.hpp"
+#include "timeman.hpp"
+#include "tt.hpp"
+#include "vorpal_helpers.hpp"
+
+using U64 = unsigned long long;
+
+// the deepest the search can go, counting extensions and quiescence
+constexpr int MAX_PLY = 128;
+
+// mate scores count down from MATE by the distance to the mate, so anything
+// past MATE_BOUND is a forced mate. a tablebase mate can be found MAX_PLY into the
+// search and lie up to Tablebase::MAX_DISTANCE plies beyond, so the band covers both.
+// they still fit the 16 bits the TT stores.
+constexpr int INF_SCORE = 32000;
+constexpr int MATE = 31000;
+constexpr int MATE_BOUND = MATE - MAX_PLY - Tablebase::MAX_DISTANCE;
+
+// how often (in nodes) the search looks at the clock
+constexpr U64 CLOCK_CHECK_INTERVAL = 2048;
+
+// mate scores are stored relative to the node rather than the root, so the same
+// entry is still right when the position turns up at a different ply
+auto score_to_tt(int score, int ply) -> int {
+    if (score >= MATE_BOUND) return score + ply;
+    if (score <= -MATE_BOUND) return score - ply;
+    return score;
+}
+
+auto score_from_tt(int score, int ply) -> int {
+    if (score >= MATE_BOUND) return score - ply;
+    if (score <= -MATE_BOUND) return score + ply;
+    return score;
+}
+
+// "cp 25" or "mate 3" (in moves, negative when we are the side getting mated)
+auto score_notation(int score) -> std::string {
+    if (score >= MATE_BOUND) return "mate " + std::to_string((MATE - score + 1) / 2);
+    if (score <= -MATE_BOUND) return "mate " + std::to_string(-(MATE + score) / 2);
+    return "cp " + std::to_string(score);
+}
+
+// a tablebase result as a search score. the tables know the exact distance to mate,
+// so a won or lost position scores just like a mate the search found itself.
+auto tablebase_score(uint8_t code, int ply, int draw) -> int {
+    if (Tablebase::is_win(code)) return MATE - ply - Tablebase::distance(code);
+    if (Tablebase::is_loss(code)) return -MATE + ply + Tablebase::distance(code);
+    return draw;
+}
+
+// late move reductions by depth and move number, log(depth) * log(moves) shaped
+class ReductionTable {
+   public:
+    int table[64][64];
+
+    ReductionTable() {
+        for (int depth = 0; depth < 64; depth++) {
+            for (int moves = 0; moves < 64; moves++) {
+                table[depth][moves] = depth && moves ? (int)(0.75 + std::log(depth) * std::log(moves) / 2.25) : 0;
+            }
+        }
+    }
+
+    auto get(int depth, int moves) const -> int {
+        return table[std::min(depth, 63)][std::min(moves, 63)];
+    }
+};
+
+const ReductionTable REDUCTIONS;
+
+// one thread's worth of search: a private copy of the position and its own
+// killer, PV and pawn hash tables, sharing only the transposition table and the stop flag.
+// only the main thread watches the clock, the helpers stop when it tells them to.
+class Searcher {
+   public:
+    State state;
+    TranspositionTable& tt;
+    std::atomic<bool>& stopped;
+
+    // the side to move at the root gets -contempt for a draw, the opponent +contempt
+    int contempt = 0;
+    Colour root_turn = WHITE;
+    // positions with this many men or fewer are looked up in the tablebases
+    int tb_limit = 0;
+    // the hard time limit is polled through this, nullptr for none
+    const TimeManager* time = nullptr;
+    // stop after this many nodes of this thread's own, 0 for no limit
+    U64 node_limit = 0;
+    // the clock doesn't run while this is set (pondering), only stop ends the search
+    const std::atomic<bool>* pondering = nullptr;
+
+    // read by the main thread while this one searches, so kept atomic (relaxed, it's just a counter)
+    std::atomic<U64> nodes{0};
+    int seldepth = 0;
+    U64 tb_hits = 0;
+    // only counted in a profiling build
+    Profile::SearchStats stats;
+    Move killers[MAX_PLY + 1][NUM_KILLERS];
+    History history;
+    // the move made at each ply of the current line and the piece that made it
+    // (NULL_MOVE and NO_PIECE for a null move), for the countermove and continuation tables
+    Move played[MAX_PLY + 1];
+    Piece moved_piece[MAX_PLY + 1];
+    Eval::PawnTable pawn_table;
+    // triangular PV table, pv[ply] holds the line from ply onwards
+    Move pv[MAX_PLY + 1][MAX_PLY + 1];
+    int pv_length[MAX_PLY + 1];
+
+    Searcher(const State& root, TranspositionTable& table, std::atomic<bool>& stop_flag)
+        : state(root), tt(table), stopped(stop_flag) {
+        root_turn = state.turn;
+        // the root may have been set up before a network was loaded
+        state.refresh_accumulator();
+        clear_tables();
+    }
+
+    void clear_tables() {
+        for (auto& ply : killers) {
+            for (Move& killer : ply) killer = NULL_MOVE;
+        }
+        history.clear();
+        for (int& length : pv_length) length = 0;
+    }
+
+    auto best_move() const -> Move {
+        return pv_length[0] ? pv[0][0] : NULL_MOVE;
+    }
+
+    auto draw_score() const -> int {
+        return state.turn == root_turn ? -contempt : contempt;
+    }
+
+    // counts the node and every so often checks the clock
+    void visit(int ply) {
+        U64 count = nodes.load(std::memory_order_relaxed) + 1;
+        nodes.store(count, std::memory_order_relaxed);
+        seldepth = std::max(seldepth, ply);
+        if (time && count % CLOCK_CHECK_INTERVAL == 0 && time->out_of_time() &&
+            !(pondering && pondering->load(std::memory_order_relaxed))) {
+            stopped.store(true, std::memory_order_relaxed);
+        }
+        if (node_limit && count >= node_limit) stopped.store(true, std::memory_order_relaxed);
+    }
+
+    // the move the PV expects in reply to the best one, to ponder on
+    auto ponder_move() const -> Move {
+        return pv_length[0] > 1 ? pv[0][1] : NULL_MOVE;
+    }
+
+    auto is_stopped() const -> bool {
+        return stopped.load(std::memory_order_relaxed);
+    }
+
+    auto has_non_pawn_material(Colour colour) const -> bool {
+        return state.occupied_co[colour] & ~(state.pieces[PAWN] | state.pieces[KING]);
+    }
+
+    void stat(U64 Profile::SearchStats::*field) {
+        if constexpr (Profile::ENABLED) (stats.*field)++;
+    }
+
+    void update_pv(int ply, Move move) {
+        pv[ply][ply] = move;
+        for (int i = ply + 1; i < pv_length[ply + 1]; i++) pv[ply][i] = pv[ply + 1][i];
+        pv_length[ply] = std::max(pv_length[ply + 1], ply + 1);
+    }
+
+    void store_killer(int ply, Move move) {
+        if (killers[ply][0] == move) return;
+        killers[ply][1] = killers[ply][0];
+        killers[ply][0] = move;
+    }
+
+    // the continuation table for following up the move made `back` plies before this one,
+    // nullptr if there's no such move
+    auto continuation(int ply, int back) -> PieceToHistory* {
+        if (ply < back || moved_piece[ply - back] == NO_PIECE) return nullptr;
+        Colour mover = back % 2 ? !state.turn : state.turn;
+        return &history.continuation[back - 1][mover][moved_piece[ply - back]][played[ply - back].get_to()];
+    }
+
+    auto counter_move(int ply) const -> Move {
+        if (ply == 0 || played[ply - 1].is_null()) return NULL_MOVE;
+        return history.counter_moves[played[ply - 1].get_from()][played[ply - 1].get_to()];
+    }
+
+    // a quiet move caused a cutoff: it goes up in every table, and the quiet moves
+    // searched before it (which didn't) go down by as much
+    void reward_quiet(int ply, int depth, Move best, const Move* tried, int num_tried) {
+        store_killer(ply, best);
+        if (ply > 0 && !played[ply - 1].is_null()) {
+            history.counter_moves[played[ply - 1].get_from()][played[ply - 1].get_to()] = best;
+        }
+        int bonus = std::min(16 * depth * depth, 1600);
+        PieceToHistory* continuations[2] = {continuation(ply, 1), continuation(ply, 2)};
+        auto update = [&](Move move, int amount) {
+            Square from_square = (Square)move.get_from();
+            Square to_square = (Square)move.get_to();
+            Piece piece = state.piece_type_at(from_square);
+            History::update(history.butterfly[state.turn][from_square][to_square], amount);
+            for (PieceToHistory* table : continuations) {
+                if (table) History::update((*table)[piece][to_square], amount);
+            }
+        };
+        update(best, bonus);
+        for (int i = 0; i < num_tried; i++) update(tried[i], -bonus);
+    }
+
+    // captures (and promotions) only, until the position is quiet. when in check
+    // every evasion is searched, since standing pat isn't an option.
+    auto quiescence(int alpha, int beta, int ply) -> int {
+        visit(ply);
+        pv_length[ply] = ply;
+        if (is_stopped()) return 0;
+        if (ply >= MAX_PLY) return evaluate(state, pawn_table);
+        stat(&Profile::SearchStats::qnodes);
+
+        TTData entry;
+        stat(&Profile::SearchStats::tt_probes);
+        if (tt.probe(state.key, entry)) {
+            stat(&Profile::SearchStats::tt_hits);
+            int tt_score = score_from_tt(entry.score, ply);
+            if (entry.bound == BOUND_EXACT ||
+                (entry.bound == BOUND_LOWER && tt_score >= beta) ||
+                (entry.bound == BOUND_UPPER && tt_score <= alpha)) {
+                return tt_score;
+            }
+        }
+
+        bool in_check = state.is_check();
+        int best_score = -INF_SCORE;
+        if (!in_check) {
+            best_score = evaluate(state, pawn_table);
+            if (best_score >= beta) return best_score;
+            alpha = std::max(alpha, best_score);
+        }
+
+        MovePicker picker = in_check ? MovePicker(state, NULL_MOVE, killers[ply]) : MovePicker(state);
+        Move move;
+        int moves_searched = 0;
+        while (picker.next(move)) {
+            tt.prefetch(state.key_after(move));
+            played[ply] = move;
+            moved_piece[ply] = state.piece_type_at((Square)move.get_from());
+            state.push(move);
+            int score = -quiescence(-beta, -alpha, ply + 1);
+            state.pop(move);
+            moves_searched++;
+            if (is_stopped()) return 0;
+
+            if (score > best_score) {
+                best_score = score;
+                if (score > alpha) {
+                    alpha = score;
+                    update_pv(ply, move);
+                    if (alpha >= beta) break;
+                }
+            }
+        }
+        if (in_check && moves_searched == 0) return -MATE + ply;
+        return best_score;
+    }
+
+    // principal variation search: the first move gets the full window, every later one a
+    // null window around alpha that is only widened again if the move turns out better
+    auto negamax(int alpha, int beta, int depth, int ply, bool null_allowed = true) -> int {
+        if (depth <= 0) return quiescence(alpha, beta, ply);
+
+        visit(ply);
+        pv_length[ply] = ply;
+        if (is_stopped()) return 0;
+
+        const bool root = ply == 0;
+        const bool pv_node = beta - alpha > 1;
+
+        if (!root) {
+            if (state.is_repetition() || state.is_fifty_moves() || state.is_insufficient_material()) {
+                return draw_score();
+            }
+            if (ply >= MAX_PLY) return evaluate(state, pawn_table);
+            uint8_t code;
+            if (popcount(state.occupied) <= tb_limit && Tablebase::TABLEBASES.probe(state, code)) {
+                tb_hits++;
+                return tablebase_score(code, ply, draw_score());
+            }
+            // mate distance pruning: no line from here can beat a mate we already have
+            alpha = std::max(alpha, -MATE + ply);
+            beta = std::min(beta, MATE - ply - 1);
+            if (alpha >= beta) return alpha;
+        }
+
+        TTData entry;
+        bool tt_hit = tt.probe(state.key, entry);
+        stat(&Profile::SearchStats::tt_probes);
+        if (tt_hit) stat(&Profile::SearchStats::tt_hits);
+        Move tt_move = tt_hit ? entry.move : NULL_MOVE;
+        if (tt_hit && !pv_node && entry.depth >= depth) {
+            int tt_score = score_from_tt(entry.score, ply);
+            if (entry.bound == BOUND_EXACT ||
+                (entry.bound == BOUND_LOWER && tt_score >= beta) ||
+                (entry.bound == BOUND_UPPER && tt_score <= alpha)) {
+                return tt_score;
+            }
+        }
+
+        const bool in_check = state.is_check();
+        const int static_eval = in_check ? -INF_SCORE : tt_hit ? entry.eval : evaluate(state, pawn_table);
+        for (Move& killer : killers[ply + 1]) killer = NULL_MOVE;
+
+        // null move pruning: if passing still fails high, a real move will too.
+        // not in zugzwang-prone positions where the side to move has only pawns.
+        if (!pv_node && !in_check && null_allowed && depth >= 3 && static_eval >= beta &&
+            has_non_pawn_material(state.turn)) {
+            int reduction = 3 + depth / 6;
+            played[ply] = NULL_MOVE;
+            moved_piece[ply] = NO_PIECE;
+            state.nullmove();
+            int score = -negamax(-beta, -beta + 1, depth - 1 - reduction, ply + 1, false);
+            state.pop_nullmove();
+            if (is_stopped()) return 0;
+            stat(&Profile::SearchStats::null_tries);
+            if (score >= beta) {
+                stat(&Profile::SearchStats::null_cutoffs);
+                return score >= MATE_BOUND ? beta : score;
+            }
+        }
+
+        MovePicker picker(state, tt_move, killers[ply], &history, counter_move(ply), continuation(ply, 1),
+                          continuation(ply, 2));
+        const int original_alpha = alpha;
+        int best_score = -INF_SCORE;
+        Move best = NULL_MOVE;
+        int moves_searched = 0;
+        Move quiets_tried[MAX_MOVES];
+        int num_quiets = 0;
+        Move move;
+        while (picker.next(move)) {
+            const bool quiet = !move.is_capture() && !move.is_promotion();
+            tt.prefetch(state.key_after(move));
+            played[ply] = move;
+            moved_piece[ply] = state.piece_type_at((Square)move.get_from());
+            state.push(move);
+            const bool gives_check = state.is_check();
+            // check extension
+            const int new_depth = depth - 1 + gives_check;
+
+            int score;
+            if (moves_searched == 0) {
+                score = -negamax(-beta, -alpha, new_depth, ply + 1);
+            } else {
+                // late move reductions: quiet moves far down the list are searched
+                // shallower first, and only get the full depth if they beat alpha
+                int reduction = 0;
+                if (depth >= 3 && quiet && !in_check && !gives_check && moves_searched >= 2 + 2 * pv_node) {
+                    reduction = REDUCTIONS.get(depth, moves_searched) - pv_node;
+                    reduction = std::clamp(reduction, 0, new_depth - 1);
+                }
+                score = -negamax(-alpha - 1, -alpha, new_depth - reduction, ply + 1);
+                if (reduction) stat(&Profile::SearchStats::lmr_tries);
+                if (score > alpha && reduction) {
+                    stat(&Profile::SearchStats::lmr_research);
+                    score = -negamax(-alpha - 1, -alpha, new_depth, ply + 1);
+                }
+                if (score > alpha && score < beta) {
+                    score = -negamax(-beta, -alpha, new_depth, ply + 1);
+                }
+            }
+            state.pop(move);
+            moves_searched++;
+            if (is_stopped()) return 0;
+
+            if (score > best_score) {
+                best_score = score;
+                if (score > alpha) {
+                    alpha = score;
+                    best = move;
+                    update_pv(ply, move);
+                    if (alpha >= beta) {
+                        stat(&Profile::SearchStats::cutoffs);
+                        if (moves_searched == 1) stat(&Profile::SearchStats::first_move_cutoffs);
+                        if (quiet) reward_quiet(ply, depth, move, quiets_tried, num_quiets);
+                        break;
+                    }
+                }
+            }
+            if (quiet && num_quiets < MAX_MOVES) quiets_tried[num_quiets++] = move;
+        }
+
+        if (moves_searched == 0) return in_check ? -MATE + ply : draw_score();
+
+        Bound bound = best_score >= beta ? BOUND_LOWER : best_score > original_alpha ? BOUND_EXACT : BOUND_UPPER;
+        tt.store(state.key, best, score_to_tt(best_score, ply), in_check ? 0 : static_eval, depth, bound);
+        return best_score;
+    }
+
+    // one iteration, searched through a narrow window around the last score that
+    // widens on whichever side it fails until the score lands inside it
+    auto aspiration(int depth, int previous_score) -> int {
+        int window = 25;
+        int alpha = -INF_SCORE;
+        int beta = INF_SCORE;
+        if (depth >= 4) {
+            alpha = std::max(previous_score - window, -INF_SCORE);
+            beta = std::min(previous_score + window, INF_SCORE);
+        }
+        while (true) {
+            int score = negamax(alpha, beta, depth, 0);
+            if (is_stopped()) return score;
+            if (score <= alpha) {
+                beta = (alpha + beta) / 2;
+                alpha = std::max(score - window, -INF_SCORE);
+            } else if (score >= beta) {
+                beta = std::min(score + window, INF_SCORE);
+            } else {
+                return score;
+            }
+            window *= 2;
+        }
+    }
+};
@@ -1,16 +1,63 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
-#include <vector>
+#include <cctype>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <type_traits>
 
 #include "move.hpp"
 #include "movegen.hpp"
 #include "names.hpp"
 #include "MaskSet.hpp"
+#include "nnue.hpp"
+#include "profile.hpp"
+#include "psqt.hpp"
+#include "zobrist.hpp"
 
 using U64 = unsigned long long;
 
+// the longest game (in plies) that the undo history can hold
+constexpr int MAX_GAME_PLIES = 1024;
+
+// piece values for static exchange evaluation, by Piece
+constexpr int SEE_VALUES[] = {100, 320, 330, 500, 950, 20000, 0};
+
+// everything push() destroys that pop() can't work out from the move itself
+struct Undo {
+    U64 ep_square;
+    U64 castling_rights;
+    U64 promoted;
+    U64 pawn_key;
+    int halfmove_clock;
+    Piece captured;
+};
+
+// which moves a generator emits. captures includes every promotion, quiets is everything else.
+enum MoveGenType : uint8_t {
+    GEN_CAPTURES,
+    GEN_QUIETS,
+    GEN_ALL
+};
+
+// everything the generators need to emit only legal moves, worked out once per node
+struct Legality {
+    Square king;
+    // their pieces giving check
+    U64 checkers;
+    // the squares a non-king move has to land on: anywhere when not in check, the checker
+    // or a square between it and the king in single check, nowhere in double check
+    U64 check_mask;
+    // our pieces pinned to our king, which can only move along MASKS.LINE[king][from]
+    U64 pinned;
+    // the squares our king can't step to
+    U64 king_danger;
+};
+
 class State {
+   public:
     U64 occupied;
     U64 occupied_co[2];
     U64 pieces[6];
@@ -20,11 +67,19 @@ class State {
     Colour turn;
     int movecount;
     int halfmove_clock;  // resets on captures and pawn moves
-    std::vector<Move> move_stack;
+    U64 key;       // zobrist key of the whole position
+    U64 pawn_key;  // zobrist key of the pawns alone
+    Score psqt;    // material and piece-square score, white's point of view
+    int phase;     // game phase from the pieces left, Psqt::PHASE_TOTAL at the start
+    // the network's hidden layer for this position, only kept while a network is loaded
+    Nnue::Accumulator accumulator;
+    std::array<Undo, MAX_GAME_PLIES> history;
+    // the key before each move in history, kept apart from the undo records so that
+    // the repetition scan walks a dense array
+    std::array<U64, MAX_GAME_PLIES> key_history;
+    int history_len;
 
-    MaskSet* masks;
-
-    State(MaskSet* m = nullptr) {
+    State() {
         occupied = BB_RANK_2 | BB_RANK_7 | BB_BACKRANKS;
         occupied_co[WHITE] = BB_RANK_1 | BB_RANK_2;
         occupied_co[BLACK] = BB_RANK_7 | BB_RANK_8;
@@ -37,12 +92,14 @@ class State {
         promoted = BB_EMPTY;
         ep_square = BB_EMPTY;
         castling_rights = BB_CORNERS;
+        turn = WHITE;
         movecount = 0;
-        if (!m) {
-            masks = new MaskSet();
-        } else {
-            masks = m;
-        }
+        halfmove_clock = 0;
+        history_len = 0;
+        key = compute_key();
+        pawn_key = compute_pawn_key();
+        compute_psqt();
+        refresh_accumulator();
     }
 
     /////////////////////////////////////////////////////////////
@@ -56,48 +113,499 @@ class State {
         occupied_co[colour] |= adding_bb;
         for (U64& bb : pieces) bb &= ~adding_bb;
         pieces[piece] |= adding_bb;
+        key = compute_key();
+        pawn_key = compute_pawn_key();
+        compute_psqt();
+        refresh_accumulator();
+    }
+
+    // the zobrist keys from scratch, push() and pop() keep them up to date incrementally
+    auto compute_key() const -> U64 {
+        U64 k = compute_pawn_key();
+        for (int piece = KNIGHT; piece <= KING; piece++) {
+            for (Colour colour : {WHITE, BLACK}) {
+                for (U64 bb = pieces[piece] & occupied_co[colour]; bb; bb &= bb - 1) {
+                    k ^= Zobrist::piece_key(colour, (Piece)piece, bitscan_forward(bb));
+                }
+            }
+        }
+        k ^= Zobrist::castling_key(castling_rights);
+        k ^= Zobrist::ep_key(ep_square);
+        if (turn == BLACK) k ^= Zobrist::KEYS.side;
+        return k;
+    }
+
+    auto compute_pawn_key() const -> U64 {
+        U64 k = 0;
+        for (Colour colour : {WHITE, BLACK}) {
+            for (U64 bb = pieces[PAWN] & occupied_co[colour]; bb; bb &= bb - 1) {
+                k ^= Zobrist::piece_key(colour, PAWN, bitscan_forward(bb));
+            }
+        }
+        return k;
+    }
+
+    // the accumulator from scratch, for a position set up before the network was loaded
+    void refresh_accumulator() {
+        if (Nnue::ACTIVE) Nnue::refresh(accumulator, occupied_co, pieces);
+    }
+
+    // the material and piece-square score and the phase from scratch,
+    // which the add/remove/move primitives then keep up to date
+    void compute_psqt() {
+        psqt = 0;
+        phase = 0;
+        for (int piece = PAWN; piece <= KING; piece++) {
+            for (Colour colour : {WHITE, BLACK}) {
+                for (U64 bb = pieces[piece] & occupied_co[colour]; bb; bb &= bb - 1) {
+                    psqt += Psqt::value(colour, (Piece)piece, bitscan_forward(bb));
+                    phase += Psqt::PHASE_WEIGHT[piece];
+                }
+            }
+        }
+    }
+
+    // sets up the position from a FEN string, clearing the undo history. a string that
+    // isn't a position the move generator can be trusted with is refused and the state
+    // left as it was: each side needs exactly one king and at most sixteen pieces, no pawns
+    // on the back ranks, castling rights only with the king and rook at home, an en passant
+    // square only behind a pawn that can just have pushed two, and the side that just moved
+    // not in check. the two clocks may be left off.
+    auto load_fen(const std::string& fen) -> bool {
+        std::istringstream fields(fen);
+        std::string board, side, castling, ep, halfmove, fullmove;
+        if (!(fields >> board >> side >> castling >> ep)) return false;
+        if (!(fields >> halfmove)) halfmove = "0";
+        if (!(fields >> fullmove)) fullmove = "1";
+
+        // the board runs from the eighth rank down, each rank from the a-file across
+        U64 new_co[2] = {BB_EMPTY, BB_EMPTY};
+        U64 new_pieces[6] = {BB_EMPTY, BB_EMPTY, BB_EMPTY, BB_EMPTY, BB_EMPTY, BB_EMPTY};
+        int rank = 7;
+        int file = 0;
+        for (char c : board) {
+            if (c == '/') {
+                if (file != 8 || rank == 0) return false;
+                rank--;
+                file = 0;
+            } else if (c >= '1' && c <= '8') {
+                file += c - '0';
+                if (file > 8) return false;
+            } else {
+                size_t piece = std::string("pnbrqk").find((char)std::tolower((unsigned char)c));
+                if (piece == std::string::npos || file > 7) return false;
+                U64 bb = 1ULL << (rank * 8 + file);
+                new_co[std::isupper((unsigned char)c) ? WHITE : BLACK] |= bb;
+                new_pieces[piece] |= bb;
+                file++;
+            }
+        }
+        if (rank != 0 || file != 8) return false;
+        for (Colour colour : {WHITE, BLACK}) {
+            if (popcount(new_pieces[KING] & new_co[colour]) != 1) return false;
+            if (popcount(new_co[colour]) > 16) return false;
+        }
+        if (new_pieces[PAWN] & BB_BACKRANKS) return false;
+
+        if (side != "w" && side != "b") return false;
+        Colour us = side == "w" ? WHITE : BLACK;
+
+        U64 rights = BB_EMPTY;
+        if (castling != "-") {
+            for (char c : castling) {
+                size_t right = std::string("KQkq").find(c);
+                if (right == std::string::npos) return false;
+                Colour colour = right < 2 ? WHITE : BLACK;
+                U64 king = colour == WHITE ? BB_E1 : BB_E8;
+                U64 rook = right == 0 ? BB_H1 : right == 1 ? BB_A1 : right == 2 ? BB_H8 : BB_A8;
+                if (!(new_pieces[KING] & new_co[colour] & king) || !(new_pieces[ROOK] & new_co[colour] & rook)) {
+                    return false;
+                }
+                rights |= rook;
+            }
+        }
+
+        U64 new_ep = BB_EMPTY;
+        if (ep != "-") {
+            if (ep.size() != 2 || ep[0] < 'a' || ep[0] > 'h' || ep[1] != (us == WHITE ? '6' : '3')) return false;
+            int square = (ep[0] - 'a') + 8 * (ep[1] - '1');
+            int pushed = us == WHITE ? square - 8 : square + 8;
+            int origin = us == WHITE ? square + 8 : square - 8;
+            U64 all = new_co[WHITE] | new_co[BLACK];
+            if (!(new_pieces[PAWN] & new_co[!us] & (1ULL << pushed))) return false;
+            if (all & ((1ULL << square) | (1ULL << origin))) return false;
+            // kept only if one of our pawns can take there, as push() does, so a loaded
+            // position keys the same as the one reached by playing the move
+            if (BB_PAWN_ATTACKS[!us][square] & new_pieces[PAWN] & new_co[us]) new_ep = 1ULL << square;
+        }
+
+        int halfmove_count = 0;
+        int fullmove_count = 0;
+        if (!parse_count(halfmove, halfmove_count) || !parse_count(fullmove, fullmove_count)) return false;
+
+        // the check test needs the new board in place, so the old one is kept until it passes
+        U64 old_occupied = occupied;
+        U64 old_co[2];
+        U64 old_pieces[6];
+        std::copy(std::begin(occupied_co), std::end(occupied_co), old_co);
+        std::copy(std::begin(pieces), std::end(pieces), old_pieces);
+        std::copy(std::begin(new_co), std::end(new_co), occupied_co);
+        std::copy(std::begin(new_pieces), std::end(new_pieces), pieces);
+        occupied = new_co[WHITE] | new_co[BLACK];
+        if (is_square_attacked(bitscan_forward(pieces[KING] & occupied_co[!us]), us)) {
+            occupied = old_occupied;
+            std::copy(std::begin(old_co), std::end(old_co), occupied_co);
+            std::copy(std::begin(old_pieces), std::end(old_pieces), pieces);
+            return false;
+        }
+
+        promoted = BB_EMPTY;
+        turn = us;
+        castling_rights = rights;
+        ep_square = new_ep;
+        halfmove_clock = halfmove_count;
+        movecount = 2 * (std::max(fullmove_count, 1) - 1) + (turn == BLACK);
+        history_len = 0;
+        key = compute_key();
+        pawn_key = compute_pawn_key();
+        compute_psqt();
+        refresh_accumulator();
+        return true;
+    }
+
+    // a FEN clock: digits only, and small enough that the move count made from it fits an int
+    static auto parse_count(const std::string& text, int& count) -> bool {
+        if (text.empty() || text.size() > 6) return false;
+        for (char c : text) {
+            if (c < '0' || c > '9') return false;
+        }
+        count = std::stoi(text);
+        return true;
+    }
+
+    // the position as a FEN string, the inverse of load_fen
+    auto fen() const -> std::string {
+        std::string out;
+        for (int rank = 7; rank >= 0; rank--) {
+            int empty = 0;
+            for (int file = 0; file < 8; file++) {
+                Square square = (Square)(rank * 8 + file);
+                Piece piece = piece_type_at(square);
+                if (piece == NO_PIECE) {
+                    empty++;
+                    continue;
+                }
+                if (empty) out += (char)('0' + empty);
+                empty = 0;
+                char c = "pnbrqk"[piece];
+                out += (occupied_co[WHITE] >> square) & 1 ? (char)std::toupper(c) : c;
+            }
+            if (empty) out += (char)('0' + empty);
+            if (rank) out += '/';
+        }
+
+        out += turn == WHITE ? " w " : " b ";
+
+        std::string castling;
+        if (castling_rights & BB_H1) castling += 'K';
+        if (castling_rights & BB_A1) castling += 'Q';
+        if (castling_rights & BB_H8) castling += 'k';
+        if (castling_rights & BB_A8) castling += 'q';
+        out += castling.empty() ? "-" : castling;
+
+        if (ep_square) {
+            int ep = __builtin_ctzll(ep_square);
+            out += ' ';
+            out += (char)('a' + ep % 8);
+            out += (char)('1' + ep / 8);
+        } else {
+            out += " -";
+        }
+
+        out += " " + std::to_string(halfmove_clock) + " " + std::to_string(movecount / 2 + 1);
+        return out;
     }
 
     /////////////////////////////////////////////////////////////
     /////////////////////// MOVE HANDLING ///////////////////////
     /////////////////////////////////////////////////////////////
 
+    // the type of the piece on a square, or NO_PIECE if it's empty
+    auto piece_type_at(Square square) const -> Piece {
+        U64 bb = 1ULL << square;
+        if (!(occupied & bb)) return NO_PIECE;
+        if (pieces[PAWN] & bb) return PAWN;
+        if (pieces[KNIGHT] & bb) return KNIGHT;
+        if (pieces[BISHOP] & bb) return BISHOP;
+        if (pieces[ROOK] & bb) return ROOK;
+        if (pieces[QUEEN] & bb) return QUEEN;
+        return KING;
+    }
+
+    // the three primitives that push() and pop() are built out of.
+    // they assume the board is consistent (nothing on the square being added to, etc.)
+    // besides the bitboards they keep the keys, the piece-square score and the network
+    // accumulator up to date, and since pop() undoes a move through them too, neither
+    // needs an undo record.
+
+    void add_piece(Square square, Piece piece, Colour colour) {
+        U64 bb = 1ULL << square;
+        occupied ^= bb;
+        occupied_co[colour] ^= bb;
+        pieces[piece] ^= bb;
+        U64 k = Zobrist::piece_key(colour, piece, square);
+        key ^= k;
+        if (piece == PAWN) pawn_key ^= k;
+        psqt += Psqt::value(colour, piece, square);
+        phase += Psqt::PHASE_WEIGHT[piece];
+        if (Nnue::ACTIVE) Nnue::add_piece(accumulator, colour, piece, square);
+    }
+
+    void remove_piece(Square square, Piece piece, Colour colour) {
+        U64 bb = 1ULL << square;
+        occupied ^= bb;
+        occupied_co[colour] ^= bb;
+        pieces[piece] ^= bb;
+        U64 k = Zobrist::piece_key(colour, piece, square);
+        key ^= k;
+        if (piece == PAWN) pawn_key ^= k;
+        psqt -= Psqt::value(colour, piece, square);
+        phase -= Psqt::PHASE_WEIGHT[piece];
+        if (Nnue::ACTIVE) Nnue::remove_piece(accumulator, colour, piece, square);
+    }
+
+    void move_piece(Square from, Square to, Piece piece, Colour colour) {
+        U64 from_to = (1ULL << from) | (1ULL << to);
+        occupied ^= from_to;
+        occupied_co[colour] ^= from_to;
+        pieces[piece] ^= from_to;
+        U64 k = Zobrist::piece_key(colour, piece, from) ^ Zobrist::piece_key(colour, piece, to);
+        key ^= k;
+        if (piece == PAWN) pawn_key ^= k;
+        psqt += Psqt::value(colour, piece, to) - Psqt::value(colour, piece, from);
+        if (Nnue::ACTIVE) Nnue::move_piece(accumulator, colour, piece, from, to);
+    }
+
+    // flags & 0b11 runs knight, bishop, rook, queen for the promotion codes
+    static auto promotion_piece(uint flags) -> Piece {
+        return (Piece)(KNIGHT + (flags & 0b11));
+    }
+
+    // a cheap guess at the key after a move, good enough to prefetch its hash table bucket
+    // before push(). it ignores castling rights, ep squares and the castling rook, so it
+    // is exact only for ordinary moves and captures.
+    auto key_after(Move move) const -> U64 {
+        Square from_square = (Square)move.get_from();
+        Square to_square = (Square)move.get_to();
+        Piece moving = piece_type_at(from_square);
+        U64 k = key ^ Zobrist::KEYS.side ^ Zobrist::ep_key(ep_square);
+        k ^= Zobrist::piece_key(turn, moving, from_square) ^ Zobrist::piece_key(turn, moving, to_square);
+        Piece captured = piece_type_at(to_square);
+        if (captured != NO_PIECE) k ^= Zobrist::piece_key(!turn, captured, to_square);
+        return k;
+    }
+
+    // make and unmake are written once for each colour, so that every "whose piece is this",
+    // pawn direction and castling square is a constant. push() and pop() pick the instantiation.
+    template <Colour US>
+    void push(Move move) {
+        constexpr Colour THEM = !US;
+        Square from_square = (Square)move.get_from();
+        Square to_square = (Square)move.get_to();
+        uint flags = move.get_flags();
+        U64 from_bb = 1ULL << from_square;
+        U64 to_bb = 1ULL << to_square;
+        Piece moving = piece_type_at(from_square);
+
+        // save the irreversible state
+        key_history[history_len] = key;
+        Undo& undo = history[history_len++];
+        undo.ep_square = ep_square;
+        undo.castling_rights = castling_rights;
+        undo.promoted = promoted;
+        undo.pawn_key = pawn_key;
+        undo.halfmove_clock = halfmove_clock;
+        undo.captured = NO_PIECE;
+
+        // the castling and ep keys come out here and go back in once the move is made
+        key ^= Zobrist::castling_key(castling_rights) ^ Zobrist::ep_key(ep_square);
+
+        halfmove_clock++;
+        ep_square = BB_EMPTY;
+
+        // take off whatever is being captured
+        if (flags == EP_FLAG) {
+            remove_piece((Square)(to_square - PAWN_STEP[US]), PAWN, THEM);
+            undo.captured = PAWN;
+        } else if (flags & CAPTURE_FLAG) {
+            undo.captured = piece_type_at(to_square);
+            remove_piece(to_square, undo.captured, THEM);
+            promoted &= ~to_bb;
+        }
+
+        // move the piece itself, swapping it for the new piece if it's a promotion
+        if (flags & PROMOTION_FLAG) {
+            remove_piece(from_square, PAWN, US);
+            add_piece(to_square, promotion_piece(flags), US);
+            promoted |= to_bb;
+        } else {
+            move_piece(from_square, to_square, moving, US);
+            if (promoted & from_bb) promoted ^= from_bb | to_bb;
+        }
+
+        // castling moves the rook too
+        if (flags == KING_CASTLE_FLAG) {
+            move_piece((Square)(H1 + HOME_RANK_SHIFT[US]), (Square)(F1 + HOME_RANK_SHIFT[US]), ROOK, US);
+        } else if (flags == QUEEN_CASTLE_FLAG) {
+            move_piece((Square)(A1 + HOME_RANK_SHIFT[US]), (Square)(D1 + HOME_RANK_SHIFT[US]), ROOK, US);
+        }
+
+        // the ep square is only recorded when one of their pawns could actually take
+        // there, so that otherwise identical positions hash the same
+        if (flags == PAWN_DOUBLE_PUSH_FLAG) {
+            Square skipped = (Square)(from_square + PAWN_STEP[US]);
+            if (BB_PAWN_ATTACKS[US][skipped] & occupied_co[THEM] & pieces[PAWN]) {
+                ep_square = 1ULL << skipped;
+            }
+        }
+
+        if (moving == PAWN || (flags & CAPTURE_FLAG)) {
+            halfmove_clock = 0;
+        }
+
+        // a king move loses both rights, moving a rook or capturing on a rook square loses that one
+        if (moving == KING) {
+            castling_rights &= ~BB_HOME_RANK[US];
+        }
+        castling_rights &= ~(from_bb | to_bb);
+
+        key ^= Zobrist::castling_key(castling_rights) ^ Zobrist::ep_key(ep_square) ^ Zobrist::KEYS.side;
+        turn = THEM;
+        movecount++;
+    }
+
+    // US is the side that made the move being taken back
+    template <Colour US>
+    void pop(Move move) {
+        constexpr Colour THEM = !US;
+        Square from_square = (Square)move.get_from();
+        Square to_square = (Square)move.get_to();
+        uint flags = move.get_flags();
+
+        turn = US;
+        movecount--;
+        const Undo& undo = history[--history_len];
+
+        if (flags & PROMOTION_FLAG) {
+            remove_piece(to_square, promotion_piece(flags), US);
+            add_piece(from_square, PAWN, US);
+        } else {
+            move_piece(to_square, from_square, piece_type_at(to_square), US);
+        }
+
+        if (flags == KING_CASTLE_FLAG) {
+            move_piece((Square)(F1 + HOME_RANK_SHIFT[US]), (Square)(H1 + HOME_RANK_SHIFT[US]), ROOK, US);
+        } else if (flags == QUEEN_CASTLE_FLAG) {
+            move_piece((Square)(D1 + HOME_RANK_SHIFT[US]), (Square)(A1 + HOME_RANK_SHIFT[US]), ROOK, US);
+        }
+
+        if (flags == EP_FLAG) {
+            add_piece((Square)(to_square - PAWN_STEP[US]), PAWN, THEM);
+        } else if (flags & CAPTURE_FLAG) {
+            add_piece(to_square, undo.captured, THEM);
+        }
+
+        ep_square = undo.ep_square;
+        castling_rights = undo.castling_rights;
+        promoted = undo.promoted;
+        halfmove_clock = undo.halfmove_clock;
+        // the piece moves above XORed the key back, but restoring it is cheaper than redoing the rest
+        key = key_history[history_len];
+        pawn_key = undo.pawn_key;
+    }
+
     void push(Move move) {
-        // TODO
+        Profile::Scope scope(Profile::PUSH);
+        if (turn == WHITE) {
+            push<WHITE>(move);
+        } else {
+            push<BLACK>(move);
+        }
     }
 
     void pop(Move move) {
-        // TODO
+        Profile::Scope scope(Profile::POP);
+        if (turn == WHITE) {
+            pop<BLACK>(move);
+        } else {
+            pop<WHITE>(move);
+        }
     }
 
+    // passes the turn, for null-move pruning. undone by pop_nullmove().
     void nullmove() {
+        key_history[history_len] = key;
+        Undo& undo = history[history_len++];
+        undo.ep_square = ep_square;
+        undo.castling_rights = castling_rights;
+        undo.promoted = promoted;
+        undo.pawn_key = pawn_key;
+        undo.halfmove_clock = halfmove_clock;
+        undo.captured = NO_PIECE;
+
+        key ^= Zobrist::ep_key(ep_square) ^ Zobrist::KEYS.side;
+        ep_square = BB_EMPTY;
+        halfmove_clock++;
+        turn = !turn;
         movecount++;
     }
 
+    void pop_nullmove() {
+        turn = !turn;
+        movecount--;
+        const Undo& undo = history[--history_len];
+        ep_square = undo.ep_square;
+        halfmove_clock = undo.halfmove_clock;
+        key = key_history[history_len];
+    }
+
+    // drops the undo records that repetition detection can no longer see: those from before
+    // the last capture or pawn move, and any past the fifty move rule's hundred plies. the
+    // moves they belong to can't be popped afterwards. keeps a long game inside MAX_GAME_PLIES.
+    void trim_history() {
+        int keep = std::min({halfmove_clock, history_len, 100});
+        int drop = history_len - keep;
+        std::copy(history.begin() + drop, history.begin() + history_len, history.begin());
+        std::copy(key_history.begin() + drop, key_history.begin() + history_len, key_history.begin());
+        history_len = keep;
+    }
+
     /////////////////////////////////////////////////////////////
     ///////////////////////// PREDICATES ////////////////////////
     /////////////////////////////////////////////////////////////
 
     /////////////////////////// CHECK ///////////////////////////
 
+    template <Colour US>
     auto is_check() const -> bool {
+        constexpr Colour THEM = !US;
         // find our king
-        Square ourKingLocation = bitscan_forward(pieces[KING] & occupied_co[turn]);
+        Square ourKingLocation = bitscan_forward(pieces[KING] & occupied_co[US]);
 
         // bitmask of the opponent's pieces
-        U64 theirPieces = occupied_co[!turn] & occupied;
+        U64 theirPieces = occupied_co[THEM];
 
-        // ideally we can just reverse pawn attack generation (note "turn" is not negated)
-        bool pawnCheck = BB_PAWN_ATTACKS[turn][ourKingLocation] & (theirPieces & pieces[PAWN]);
+        // ideally we can just reverse pawn attack generation (note "US" is not negated)
+        bool pawnCheck = BB_PAWN_ATTACKS[US][ourKingLocation] & (theirPieces & pieces[PAWN]);
 
         // if our king can attack one of their knights, like a knight,
         // then we are in check from that knight.
         bool knightCheck = BB_KNIGHT_ATTACKS[ourKingLocation] & (theirPieces & pieces[KNIGHT]);
 
         // generate bitmasks for the diagonal attacks from the king
-        U64 diaglines = get_bishop_moves_c(ourKingLocation, occupied, masks);
+        U64 diaglines = get_bishop_moves(ourKingLocation, occupied);
         // generate bitmasks for the rank & file attacks from the king
-        U64 straightlines = get_rook_moves_c(ourKingLocation, occupied, masks);
+        U64 straightlines = get_rook_moves(ourKingLocation, occupied);
 
         bool bishopCheck = diaglines & (theirPieces & pieces[BISHOP]);
         bool rookCheck = straightlines & (theirPieces & pieces[ROOK]);
@@ -106,6 +614,32 @@ class State {
         return pawnCheck || knightCheck || bishopCheck || rookCheck || queenCheck;
     }
 
+    auto is_check() const -> bool {
+        Profile::Scope scope(Profile::IS_CHECK);
+        return turn == WHITE ? is_check<WHITE>() : is_check<BLACK>();
+    }
+
+    // whether any piece of colour "by" attacks the square, using the same reversed-attack trick as is_check
+    auto is_square_attacked(Square square, Colour by) const -> bool {
+        U64 theirPieces = occupied_co[by];
+
+        // a pawn of theirs attacks the square if a pawn of ours on the square would attack it
+        if (BB_PAWN_ATTACKS[!by][square] & theirPieces & pieces[PAWN]) return true;
+        if (BB_KNIGHT_ATTACKS[square] & theirPieces & pieces[KNIGHT]) return true;
+        if (BB_KING_ATTACKS[square] & theirPieces & pieces[KING]) return true;
+
+        U64 diagonalAttackers = theirPieces & (pieces[BISHOP] | pieces[QUEEN]);
+        U64 straightAttackers = theirPieces & (pieces[ROOK] | pieces[QUEEN]);
+        return (get_bishop_moves(square, occupied) & diagonalAttackers) ||
+               (get_rook_moves(square, occupied) & straightAttackers);
+    }
+
+    // after a push(), whether the side that just moved has left its own king safe
+    auto was_legal() const -> bool {
+        Square theirKingLocation = bitscan_forward(pieces[KING] & occupied_co[!turn]);
+        return !is_square_attacked(theirKingLocation, turn);
+    }
+
     ///////////////////////// MATERIAL //////////////////////////
 
     auto is_insufficient_material() const -> bool {
@@ -117,8 +651,8 @@ class State {
         // 2. there are no knights and only light square bishops
         // 3. there are no knights and only dark square bishops
         bool knightDraw = popcount(pieces[KNIGHT]) <= 1 && pieces[BISHOP] == 0;
-        bool lightBishopDraw = pieces[BISHOP] & BB_DARK_SQUARES == 0 && pieces[KNIGHT] == 0;
-        bool darkBishopDraw = pieces[BISHOP] & BB_LIGHT_SQUARES == 0 && pieces[KNIGHT] == 0;
+        bool lightBishopDraw = (pieces[BISHOP] & BB_DARK_SQUARES) == 0 && pieces[KNIGHT] == 0;
+        bool darkBishopDraw = (pieces[BISHOP] & BB_LIGHT_SQUARES) == 0 && pieces[KNIGHT] == 0;
         // (for many of these, "popcount(bb) == 0" can be optimised to "bb == 0")
 
         return baseRequirement && (knightDraw || lightBishopDraw || darkBishopDraw);
@@ -132,14 +666,27 @@ class State {
 
     /////////////////////////// SIMPLE //////////////////////////
 
+    // whether the current position occurred at least "times" times before. only positions
+    // since the last capture or pawn move can repeat, so the scan stops halfmove_clock plies back,
+    // and it only looks at positions with the same side to move.
+    auto is_repetition(int times = 1) const -> bool {
+        int limit = std::min(halfmove_clock, history_len);
+        int seen = 0;
+        for (int back = 4; back <= limit; back += 2) {
+            if (key_history[history_len - back] == key && ++seen >= times) return true;
+        }
+        return false;
+    }
+
     auto is_threefold() const -> bool {
-        return false;  // TODO
+        return is_repetition(2);
     }
     auto is_stalemate() const -> bool {
         return num_legal_moves() == 0 && !is_check();
     }
     auto is_fifty_moves() const -> bool {
-        return halfmove_clock >= 50;
+        // the clock counts plies, fifty moves each
+        return halfmove_clock >= 100;
     }
     auto is_draw() const -> bool {
         return is_insufficient_material() || is_stalemate() || is_fifty_moves() || is_threefold();
@@ -152,225 +699,416 @@ class State {
     ////////////////////// MOVE GENERATION //////////////////////
     /////////////////////////////////////////////////////////////
 
-    auto num_legal_moves() const -> int {
-        return 0;
+    // every piece of either colour that attacks the square, given an occupancy
+    auto attackers_to(Square square, U64 occ) const -> U64 {
+        return (BB_PAWN_ATTACKS[WHITE][square] & occupied_co[BLACK] & pieces[PAWN]) |
+               (BB_PAWN_ATTACKS[BLACK][square] & occupied_co[WHITE] & pieces[PAWN]) |
+               (BB_KNIGHT_ATTACKS[square] & pieces[KNIGHT]) |
+               (BB_KING_ATTACKS[square] & pieces[KING]) |
+               (get_bishop_moves(square, occ) & (pieces[BISHOP] | pieces[QUEEN])) |
+               (get_rook_moves(square, occ) & (pieces[ROOK] | pieces[QUEEN]));
     }
 
-    void add_pawn_pushes(std::vector<Move>& movevec) {
-        U64 our_pieces = occupied_co[turn];
-        U64 our_pawns = our_pieces & pieces[PAWN];
-        // the square that a move originates from
-        Square from_square;
-        // the square that a move targets
-        Square to_square;
-        // the opponent's pieces
-        U64 targets;
-        // generate pawn pushes
-        while (our_pawns) {
-            // find the current moved piece
-            from_square = bitscan_forward(our_pawns);
-            // find the intersection of legal pawn pushes and empty squares
-            targets = ~occupied & (masks->PAWN_MOVES[turn][from_square]);
-            while (targets) {
-                // find a target square
-                to_square = bitscan_forward(targets);
-                if ((1ULL << to_square) & BB_BACKRANKS) {
-                    // emplace_back constructs a move in the vector
-                    movevec.emplace_back(
-                        from_square,
-                        to_square,
-                        KNIGHT_PROMOTION_FLAG);
-                    movevec.emplace_back(
-                        from_square,
-                        to_square,
-                        BISHOP_PROMOTION_FLAG);
-                    movevec.emplace_back(
-                        from_square,
-                        to_square,
-                        ROOK_PROMOTION_FLAG);
-                    movevec.emplace_back(
-                        from_square,
-                        to_square,
-                        QUEEN_PROMOTION_FLAG);
-                } else {
-                    // double pawn push from second rank to middle rank else normal
-                    if ((1ULL << from_square) & BB_SECOND_RANKS && (1ULL << to_square) & BB_MIDDLE_RANKS) {
-                        movevec.emplace_back(
-                            from_square,
-                            to_square,
-                            PAWN_DOUBLE_PUSH_FLAG);
-                    } else {
-                        movevec.emplace_back(
-                            from_square,
-                            to_square,
-                            QUIET_MOVE_FLAG);
-                    }
-                }
-                // clear the target push square for next run
-                targets &= targets - 1;
+    // static exchange evaluation: whether the exchange of captures that the move starts on its
+    // target square gains at least threshold for the side making it, with both sides always
+    // taking back with their least valuable attacker and free to stop when it suits them.
+    // x-rays are picked up as pieces leave the square's lines; pins and checks are ignored.
+    auto see_ge(Move move, int threshold) const -> bool {
+        uint flags = move.get_flags();
+        if (flags == KING_CASTLE_FLAG || flags == QUEEN_CASTLE_FLAG) return 0 >= threshold;
+        Square from_square = (Square)move.get_from();
+        Square to_square = (Square)move.get_to();
+        Piece victim = flags == EP_FLAG ? PAWN : piece_type_at(to_square);
+        Piece next_victim = move.is_promotion() ? promotion_piece(flags) : piece_type_at(from_square);
+
+        int balance = (victim == NO_PIECE ? 0 : SEE_VALUES[victim]) - threshold;
+        if (move.is_promotion()) balance += SEE_VALUES[next_victim] - SEE_VALUES[PAWN];
+        if (balance < 0) return false;
+        // the worst case: the moved piece is lost for nothing
+        balance -= SEE_VALUES[next_victim];
+        if (balance >= 0) return true;
+
+        U64 occ = occupied ^ (1ULL << from_square) ^ (1ULL << to_square);
+        if (flags == EP_FLAG) occ ^= 1ULL << (to_square ^ 8);
+        U64 diagonal = pieces[BISHOP] | pieces[QUEEN];
+        U64 straight = pieces[ROOK] | pieces[QUEEN];
+        U64 attackers = attackers_to(to_square, occ) & occ;
+        Colour side = !turn;
+        while (true) {
+            U64 ours = attackers & occupied_co[side];
+            if (!ours) break;
+            Piece attacker = PAWN;
+            while (!(ours & pieces[attacker])) attacker = (Piece)(attacker + 1);
+            occ ^= (ours & pieces[attacker]) & -(ours & pieces[attacker]);
+            // whatever stood behind the piece that just took now sees the square
+            if (attacker == PAWN || attacker == BISHOP || attacker == QUEEN) attackers |= get_bishop_moves(to_square, occ) & diagonal;
+            if (attacker == ROOK || attacker == QUEEN) attackers |= get_rook_moves(to_square, occ) & straight;
+            attackers &= occ;
+            side = !side;
+            balance = -balance - 1 - SEE_VALUES[attacker];
+            if (balance >= 0) {
+                // a king can't take if the square is still defended
+                if (attacker == KING && (attackers & occupied_co[side])) side = !side;
+                break;
             }
-            // clear the pawn from_square for next run
-            our_pawns &= our_pawns - 1;
         }
+        // whoever is left to move at the end is the one who lost the exchange
+        return side != turn;
     }
 
-    void add_pawn_captures(std::vector<Move>& movevec) {
-        U64 our_pieces = occupied_co[turn];
-        U64 our_pawns = our_pieces & pieces[PAWN];
-        // the square that a move originates from
-        uint_fast8_t from_square;
-        // the square that a move targets
-        uint_fast8_t to_square;
-        // the opponent's pieces
-        U64 targets;
-        // generate pawn captures
-        while (our_pawns) {
-            // find the current moved piece
-            from_square = bitscan_forward(our_pawns);
-            // find the intersection of legal pawn attacks and the opponent's pieces
-            targets = (occupied_co[!turn] | ep_square) & BB_PAWN_ATTACKS[turn][from_square];
-            while (targets) {
-                // find a target square
-                to_square = bitscan_forward(targets);
-                if ((1ULL << to_square) & BB_BACKRANKS) {
-                    // emplace_back constructs a move in the vector
-                    movevec.emplace_back(
-                        from_square,
-                        to_square,
-                        KNIGHT_PROMOTION_FLAG | CAPTURE_FLAG);
-                    movevec.emplace_back(
-                        from_square,
-                        to_square,
-                        BISHOP_PROMOTION_FLAG | CAPTURE_FLAG);
-                    movevec.emplace_back(
-                        from_square,
-                        to_square,
-                        ROOK_PROMOTION_FLAG | CAPTURE_FLAG);
-                    movevec.emplace_back(
-                        from_square,
-                        to_square,
-                        QUEEN_PROMOTION_FLAG | CAPTURE_FLAG);
-                } else {
-                    // test for en passant
-                    if ((1ULL << to_square) & ep_square) {
-                        movevec.emplace_back(
-                            from_square,
-                            to_square,
-                            EP_FLAG);
-                    } else {
-                        movevec.emplace_back(
-                            from_square,
-                            to_square,
-                            CAPTURE_FLAG);
-                    }
-                }
-                // clear the target push square for next run
-                targets &= targets - 1;
+    // every square attacked by a colour, given an occupancy
+    template <Colour BY>
+    auto attack_map(U64 occ) const -> U64 {
+        U64 theirPieces = occupied_co[BY];
+        U64 attacks = BB_KING_ATTACKS[bitscan_forward(theirPieces & pieces[KING])];
+        U64 bb;
+        for (bb = theirPieces & pieces[PAWN]; bb; bb &= bb - 1) {
+            attacks |= BB_PAWN_ATTACKS[BY][bitscan_forward(bb)];
+        }
+        for (bb = theirPieces & pieces[KNIGHT]; bb; bb &= bb - 1) {
+            attacks |= BB_KNIGHT_ATTACKS[bitscan_forward(bb)];
+        }
+        for (bb = theirPieces & (pieces[BISHOP] | pieces[QUEEN]); bb; bb &= bb - 1) {
+            attacks |= get_bishop_moves(bitscan_forward(bb), occ);
+        }
+        for (bb = theirPieces & (pieces[ROOK] | pieces[QUEEN]); bb; bb &= bb - 1) {
+            attacks |= get_rook_moves(bitscan_forward(bb), occ);
+        }
+        return attacks;
+    }
+
+    // works out the checkers, the check evasion mask and the pinned pieces for US
+    template <Colour US>
+    auto legality() const -> Legality {
+        constexpr Colour THEM = !US;
+        Legality legal;
+        U64 ourPieces = occupied_co[US];
+        U64 theirPieces = occupied_co[THEM];
+        legal.king = bitscan_forward(pieces[KING] & ourPieces);
+        legal.checkers = attackers_to(legal.king, occupied) & theirPieces;
+
+        if (!legal.checkers) {
+            legal.check_mask = BB_ALL;
+        } else if (legal.checkers & (legal.checkers - 1)) {
+            // double check, nothing but the king can move
+            legal.check_mask = BB_EMPTY;
+        } else {
+            // capture the checker or block it
+            legal.check_mask = legal.checkers | MASKS.BETWEEN[legal.king][bitscan_forward(legal.checkers)];
+        }
+
+        // their sliders that would see our king if only their own pieces could block,
+        // each one pins the piece between them if exactly one of ours is in the way
+        U64 snipers = (get_bishop_moves(legal.king, theirPieces) & theirPieces & (pieces[BISHOP] | pieces[QUEEN])) |
+                      (get_rook_moves(legal.king, theirPieces) & theirPieces & (pieces[ROOK] | pieces[QUEEN]));
+        legal.pinned = BB_EMPTY;
+        while (snipers) {
+            U64 blockers = MASKS.BETWEEN[legal.king][bitscan_forward(snipers)] & occupied;
+            if (blockers && !(blockers & (blockers - 1)) && (blockers & ourPieces)) {
+                legal.pinned |= blockers;
             }
-            // clear the pawn from_square for next run
-            our_pawns &= our_pawns - 1;
+            snipers &= snipers - 1;
+        }
+
+        // the king can't step back along the line of a slider that's checking it,
+        // so the danger map is worked out with the king off the board
+        legal.king_danger = attack_map<THEM>(occupied ^ (1ULL << legal.king));
+        return legal;
+    }
+
+    auto legality() const -> Legality {
+        return turn == WHITE ? legality<WHITE>() : legality<BLACK>();
+    }
+
+    // where a piece may move to without breaking a pin: anywhere if it isn't pinned, along the pin if it is
+    auto pin_mask(const Legality& legal, Square square) const -> U64 {
+        return (legal.pinned & (1ULL << square)) ? MASKS.LINE[legal.king][square] : BB_ALL;
+    }
+
+    // en passant removes two pieces from one rank, which can expose the king in ways
+    // the pin mask doesn't see, so it gets tested directly on the resulting occupancy
+    template <Colour US>
+    auto ep_is_legal(Square from_square, const Legality& legal) const -> bool {
+        Square to_square = bitscan_forward(ep_square);
+        U64 victim = 1ULL << (to_square - PAWN_STEP[US]);
+        U64 after = (occupied ^ (1ULL << from_square) ^ victim) | ep_square;
+        U64 theirPieces = occupied_co[!US] & ~victim;
+        if (get_bishop_moves(legal.king, after) & theirPieces & (pieces[BISHOP] | pieces[QUEEN])) return false;
+        if (get_rook_moves(legal.king, after) & theirPieces & (pieces[ROOK] | pieces[QUEEN])) return false;
+        // a knight or pawn check is only answered if the pawn being taken is the checker
+        return !(legal.checkers & ~victim & (pieces[PAWN] | pieces[KNIGHT]));
+    }
+
+    // the generators are instantiated once per colour, so every colour-dependent table
+    // row, push direction and rank mask below is a compile-time constant
+
+    // a bitboard moved by a square offset, up the board for positive offsets
+    template <int OFFSET>
+    static constexpr auto shift(U64 bb) -> U64 {
+        if constexpr (OFFSET >= 0) {
+            return bb << OFFSET;
+        } else {
+            return bb >> -OFFSET;
+        }
+    }
+
+    // pawns are generated set-wise: the whole pawn bitboard is shifted onto its targets at
+    // once, and each move's from-square is its target minus the shift
+
+    template <Colour US, MoveGenType TYPE, typename Sink>
+    void add_pawn_pushes(Sink& sink, const Legality& legal) const {
+        Profile::Scope scope(Profile::GEN_PAWN_PUSHES);
+        constexpr int UP = PAWN_STEP[US];
+        U64 empty = ~occupied;
+        // a pinned pawn can still push if it's pinned along the king's file
+        U64 our_pawns = occupied_co[US] & pieces[PAWN] & (~legal.pinned | (BB_FILE_A << (legal.king % 8)));
+        // the only pushes that count as captures are promotions
+        if constexpr (TYPE == GEN_CAPTURES) {
+            // (our seventh rank is their double push rank)
+            our_pawns &= BB_DOUBLE_PUSH_RANK[!US];
+        }
+        U64 single_pushes = shift<UP>(our_pawns) & empty;
+        // the push has to answer any check
+        if constexpr (TYPE != GEN_QUIETS) {
+            sink.add_shifted_promotions(single_pushes & legal.check_mask & BB_PROMOTION_RANK[US], UP, QUIET_MOVE_FLAG);
+        }
+        if constexpr (TYPE != GEN_CAPTURES) {
+            // a pawn that stepped off our second rank onto an empty square can step again
+            U64 double_pushes = shift<UP>(single_pushes & shift<UP>(BB_DOUBLE_PUSH_RANK[US])) & empty & legal.check_mask;
+            sink.add_shifted(double_pushes, 2 * UP, PAWN_DOUBLE_PUSH_FLAG);
+            sink.add_shifted(single_pushes & legal.check_mask & ~BB_PROMOTION_RANK[US], UP, QUIET_MOVE_FLAG);
         }
     }
 
-    void add_knight_moves(std::vector<Move>& movevec) {
-        U64 our_pieces = occupied_co[turn];
-        U64 our_knights = our_pieces & pieces[KNIGHT];
+    // the captures towards the a-file and towards the h-file of a set of pawns, onto targets
+    template <Colour US, typename Sink>
+    void add_pawn_capture_set(Sink& sink, U64 pawns, U64 targets) const {
+        constexpr int WEST = PAWN_STEP[US] - 1;
+        constexpr int EAST = PAWN_STEP[US] + 1;
+        U64 west = shift<WEST>(pawns & ~BB_FILE_A) & targets;
+        U64 east = shift<EAST>(pawns & ~BB_FILE_H) & targets;
+        sink.add_shifted_promotions(west & BB_PROMOTION_RANK[US], WEST, CAPTURE_FLAG);
+        sink.add_shifted_promotions(east & BB_PROMOTION_RANK[US], EAST, CAPTURE_FLAG);
+        sink.add_shifted(west & ~BB_PROMOTION_RANK[US], WEST, CAPTURE_FLAG);
+        sink.add_shifted(east & ~BB_PROMOTION_RANK[US], EAST, CAPTURE_FLAG);
+    }
+
+    template <Colour US, MoveGenType TYPE, typename Sink>
+    void add_pawn_captures(Sink& sink, const Legality& legal) const {
+        Profile::Scope scope(Profile::GEN_PAWN_CAPTURES);
+        if constexpr (TYPE == GEN_QUIETS) return;
+        U64 our_pawns = occupied_co[US] & pieces[PAWN];
+        // captures have to answer any check
+        U64 targets = occupied_co[!US] & legal.check_mask;
+        add_pawn_capture_set<US>(sink, our_pawns & ~legal.pinned, targets);
+        // a pinned pawn can only capture along the pin, which means taking the pinner.
+        // there are rarely any, so they go one at a time
+        for (U64 pinned = our_pawns & legal.pinned; pinned; pinned &= pinned - 1) {
+            Square from_square = bitscan_forward(pinned);
+            add_pawn_capture_set<US>(sink, 1ULL << from_square, targets & MASKS.LINE[legal.king][from_square]);
+        }
+        // en passant, from the (at most two) pawns that attack the ep square
+        if (ep_square) {
+            U64 attackers = BB_PAWN_ATTACKS[!US][bitscan_forward(ep_square)] & our_pawns;
+            for (; attackers; attackers &= attackers - 1) {
+                Square from_square = bitscan_forward(attackers);
+                if (ep_is_legal<US>(from_square, legal)) sink.add(from_square, ep_square, EP_FLAG);
+            }
+        }
+    }
+
+    template <Colour US, MoveGenType TYPE, typename Sink>
+    void add_knight_moves(Sink& sink, const Legality& legal) const {
+        Profile::Scope scope(Profile::GEN_KNIGHT_MOVES);
+        U64 our_pieces = occupied_co[US];
+        // a pinned knight can never move, it always leaves the pin line
+        U64 our_knights = our_pieces & pieces[KNIGHT] & ~legal.pinned;
         // the square that a move originates from
-        uint_fast8_t from_square;
-        // the square that a move targets
-        uint_fast8_t to_square;
-        // the opponent's pieces
-        U64 capture_targets;
-        // empty slots
-        U64 quiet_targets;
+        Square from_square;
+        // the squares the knight can go to
+        U64 targets;
         // generate knight moves
         while (our_knights) {
             // find the current moved piece
             from_square = bitscan_forward(our_knights);
-            // find the intersection of knight attacks and the opponent's pieces
-            capture_targets = occupied_co[!turn] & BB_KNIGHT_ATTACKS[from_square];
-            while (capture_targets) {
-                // find a target square
-                to_square = bitscan_forward(capture_targets);
-                // add move to moves
-                movevec.emplace_back(
-                    from_square,
-                    to_square,
-                    CAPTURE_FLAG);
-                // clear the target push square for next run
-                capture_targets &= capture_targets - 1;
-            }
-            // find the intersection of knight attacks and the empty spaces
-            quiet_targets = ~occupied & BB_KNIGHT_ATTACKS[from_square];
-            while (quiet_targets) {
-                // find a target square
-                to_square = bitscan_forward(quiet_targets);
-                // add move to moves
-                movevec.emplace_back(
-                    from_square,
-                    to_square,
-                    QUIET_MOVE_FLAG);
-                // clear the target push square for next run
-                quiet_targets &= quiet_targets - 1;
-            }
-            // clear the pawn from_square for next run
+            targets = BB_KNIGHT_ATTACKS[from_square] & legal.check_mask;
+            add_piece_moves<US, TYPE>(sink, from_square, targets);
+            // clear the knight from_square for next run
             our_knights &= our_knights - 1;
         }
     }
 
-    void add_king_moves(std::vector<Move>& movevec) {
-        U64 our_pieces = occupied_co[turn];
+    template <Colour US, MoveGenType TYPE, typename Sink>
+    void add_king_moves(Sink& sink, const Legality& legal) const {
+        Profile::Scope scope(Profile::GEN_KING_MOVES);
+        // the black castling squares are the white ones moved up the board
+        constexpr int SHIFT = HOME_RANK_SHIFT[US];
         // the square that a move originates from (there's only one king)
-        uint_fast8_t from_square = bitscan_forward(our_pieces & pieces[KING]);
-        // the square that a move targets
-        uint_fast8_t to_square;
-        // the opponent's pieces
-        U64 capture_targets;
-        // empty slots
-        U64 quiet_targets;
-        // generate king moves
-        // find the intersection of king attacks and the opponent's pieces
-        capture_targets = occupied_co[!turn] & BB_KING_ATTACKS[from_square];
-        while (capture_targets) {
-            // find a target square
-            to_square = bitscan_forward(capture_targets);
-            // add move to moves
-            movevec.emplace_back(
-                from_square,
-                to_square,
-                CAPTURE_FLAG);
-            // clear the target push square for next run
-            capture_targets &= capture_targets - 1;
-        }
-        // find the intersection of king attacks and the empty spaces
-        quiet_targets = ~occupied & BB_KING_ATTACKS[from_square];
-        while (quiet_targets) {
-            // find a target square
-            to_square = bitscan_forward(quiet_targets);
-            // add move to moves
-            movevec.emplace_back(
-                from_square,
-                to_square,
-                QUIET_MOVE_FLAG);
-            // clear the target push square for next run
-            quiet_targets &= quiet_targets - 1;
-        }
-        // generate castling moves
-        if (castling_rights) {
-            // TODO
-        }
-    }
-
-    void add_bishop_moves(std::vector<Move>& movevec) {
-        
-    }
-
-    auto pseudo_legal_moves() -> std::vector<Move> {
-        std::vector<Move> moves;
-        moves.reserve(32);
-        add_pawn_pushes(moves);
-        add_pawn_captures(moves);
-        add_knight_moves(moves);
-        add_king_moves(moves);
-    }
-};
\ No newline at end of file
+        Square from_square = legal.king;
+        // the king can go anywhere adjacent that isn't attacked
+        U64 targets = BB_KING_ATTACKS[from_square] & ~legal.king_danger;
+        add_piece_moves<US, TYPE>(sink, from_square, targets);
+        // generate castling moves, never out of check
+        if (TYPE != GEN_CAPTURES && (castling_rights & BB_HOME_RANK[US]) && !legal.checkers) {
+            // kingside: nothing between the king and the rook, and the king
+            // doesn't pass through or land on an attacked square
+            if ((castling_rights & (BB_H1 << SHIFT)) &&
+                !(occupied & ((BB_F1 | BB_G1) << SHIFT)) &&
+                !(legal.king_danger & ((BB_F1 | BB_G1) << SHIFT))) {
+                sink.add(from_square, BB_G1 << SHIFT, KING_CASTLE_FLAG);
+            }
+            // queenside: the b-file square has to be empty too, but may be attacked
+            if ((castling_rights & (BB_A1 << SHIFT)) &&
+                !(occupied & ((BB_B1 | BB_C1 | BB_D1) << SHIFT)) &&
+                !(legal.king_danger & ((BB_C1 | BB_D1) << SHIFT))) {
+                sink.add(from_square, BB_C1 << SHIFT, QUEEN_CASTLE_FLAG);
+            }
+        }
+    }
+
+    // splits a piece's target squares into captures and quiet moves
+    template <Colour US, MoveGenType TYPE, typename Sink>
+    void add_piece_moves(Sink& sink, Square from_square, U64 targets) const {
+        // the intersection with the opponent's pieces, then with the empty spaces
+        if constexpr (TYPE != GEN_QUIETS) {
+            sink.add(from_square, targets & occupied_co[!US], CAPTURE_FLAG);
+        }
+        if constexpr (TYPE != GEN_CAPTURES) {
+            sink.add(from_square, targets & ~occupied, QUIET_MOVE_FLAG);
+        }
+    }
+
+    // bishops, rooks and queens all generate the same way, from their attack sets
+    template <Colour US, MoveGenType TYPE, Piece PIECE, typename Sink>
+    void add_slider_moves(Sink& sink, const Legality& legal) const {
+        U64 our_pieces = occupied_co[US];
+        U64 our_sliders = our_pieces & pieces[PIECE];
+        // the square that a move originates from
+        Square from_square;
+        // the squares the slider can go to
+        U64 targets;
+        while (our_sliders) {
+            // find the current moved piece
+            from_square = bitscan_forward(our_sliders);
+            if constexpr (PIECE == BISHOP) {
+                targets = get_bishop_moves(from_square, occupied);
+            } else if constexpr (PIECE == ROOK) {
+                targets = get_rook_moves(from_square, occupied);
+            } else {
+                targets = get_queen_moves(from_square, occupied);
+            }
+            targets &= legal.check_mask & pin_mask(legal, from_square);
+            add_piece_moves<US, TYPE>(sink, from_square, targets);
+            // clear the slider from_square for next run
+            our_sliders &= our_sliders - 1;
+        }
+    }
+
+    template <Colour US, MoveGenType TYPE, typename Sink>
+    void add_bishop_moves(Sink& sink, const Legality& legal) const {
+        Profile::Scope scope(Profile::GEN_BISHOP_MOVES);
+        add_slider_moves<US, TYPE, BISHOP>(sink, legal);
+    }
+
+    template <Colour US, MoveGenType TYPE, typename Sink>
+    void add_rook_moves(Sink& sink, const Legality& legal) const {
+        Profile::Scope scope(Profile::GEN_ROOK_MOVES);
+        add_slider_moves<US, TYPE, ROOK>(sink, legal);
+    }
+
+    template <Colour US, MoveGenType TYPE, typename Sink>
+    void add_queen_moves(Sink& sink, const Legality& legal) const {
+        Profile::Scope scope(Profile::GEN_QUEEN_MOVES);
+        add_slider_moves<US, TYPE, QUEEN>(sink, legal);
+    }
+
+    // runs every generator against the node's legality masks, so only legal moves come out.
+    // the staged move picker reuses one Legality across its generation stages.
+    template <Colour US, MoveGenType TYPE, typename Sink>
+    void generate_legal_for(Sink& sink, const Legality& legal) const {
+        // in double check only the king can move
+        if (legal.check_mask != BB_EMPTY) {
+            add_pawn_pushes<US, TYPE>(sink, legal);
+            add_pawn_captures<US, TYPE>(sink, legal);
+            add_knight_moves<US, TYPE>(sink, legal);
+            add_bishop_moves<US, TYPE>(sink, legal);
+            add_rook_moves<US, TYPE>(sink, legal);
+            add_queen_moves<US, TYPE>(sink, legal);
+        }
+        add_king_moves<US, TYPE>(sink, legal);
+    }
+
+    // the one place generation looks at the side to move
+    template <MoveGenType TYPE, typename Sink>
+    void generate_legal(Sink& sink, const Legality& legal) const {
+        if (turn == WHITE) {
+            generate_legal_for<WHITE, TYPE>(sink, legal);
+        } else {
+            generate_legal_for<BLACK, TYPE>(sink, legal);
+        }
+    }
+
+    template <MoveGenType TYPE = GEN_ALL, typename Sink>
+    void generate_legal(Sink& sink) const {
+        if (turn == WHITE) {
+            generate_legal_for<WHITE, TYPE>(sink, legality<WHITE>());
+        } else {
+            generate_legal_for<BLACK, TYPE>(sink, legality<BLACK>());
+        }
+    }
+
+    // whether a move (from the hash table, or a killer from a sibling node) is legal here.
+    // only the moved piece's own generator is run, looking for this one move.
+    template <Colour US>
+    auto is_legal(Move move, const Legality& legal) const -> bool {
+        Square from_square = (Square)move.get_from();
+        if (!(occupied_co[US] & (1ULL << from_square))) return false;
+        FindSink sink(move);
+        Piece piece = piece_type_at(from_square);
+        if (piece != KING && legal.check_mask == BB_EMPTY) return false;
+        switch (piece) {
+            case PAWN:
+                add_pawn_pushes<US, GEN_ALL>(sink, legal);
+                add_pawn_captures<US, GEN_ALL>(sink, legal);
+                break;
+            case KNIGHT:
+                add_knight_moves<US, GEN_ALL>(sink, legal);
+                break;
+            case BISHOP:
+                add_bishop_moves<US, GEN_ALL>(sink, legal);
+                break;
+            case ROOK:
+                add_rook_moves<US, GEN_ALL>(sink, legal);
+                break;
+            case QUEEN:
+                add_queen_moves<US, GEN_ALL>(sink, legal);
+                break;
+            default:
+                add_king_moves<US, GEN_ALL>(sink, legal);
+                break;
+        }
+        return sink.found;
+    }
+
+    auto is_legal(Move move, const Legality& legal) const -> bool {
+        return turn == WHITE ? is_legal<WHITE>(move, legal) : is_legal<BLACK>(move, legal);
+    }
+
+    auto legal_moves() const -> MoveList {
+        MoveList moves;
+        MoveSink sink(moves);
+        generate_legal(sink);
+        return moves;
+    }
+
+    // counts the legal moves without generating them
+    auto num_legal_moves() const -> int {
+        CountSink sink;
+        generate_legal(sink);
+        return sink.count;
+    }
+};
+
+// the tables live in MASKS, so a State is plain data: copying one (for a search thread,
+// or to copy-make) is a straight memberwise copy with nothing to allocate or rebuild
+static_assert(std::is_trivially_copyable<State>::value, "State should be trivially copyable");
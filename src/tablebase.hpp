@@ -0,0 +1,661 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "intrinsic_functions.hpp"
+#include "mapped_file.hpp"
+#include "move.hpp"
+#include "names.hpp"
+#include "state.hpp"
+
+using U64 = unsigned long long;
+
+// endgame tablebases: the exact result of every position with a few men on the board, with
+// the distance to mate, so the search can score them without searching.
+//
+// one table per material signature, named the usual way with the stronger side first
+// ("KQvKR"). the same table answers for the colours swapped, by flipping the board.
+// positions are indexed by the side to move and the square of every man, with the stronger
+// side's king folded into one corner of the board by symmetry: into the a1-d1-d4 triangle
+// (10 squares) when there are no pawns, onto files a-d (32 squares) when there are.
+//
+// every position is one byte:
+//   0          draw
+//   odd d      the side to move mates in d plies
+//   even d+2   the side to move is mated in d plies (2 is already mated)
+//
+// the tables are made by `vorpal tbgen` (see generate()) rather than read from Syzygy files,
+// and the format is our own. they assume no castling rights, and don't know the fifty-move
+// rule. a table file is mapped the first time a probe needs it, and the mapping is shared
+// by every search thread.
+//
+// file layout: "VTB1", uint8 men, uint8 longest mate in plies, 2 bytes padding,
+// uint64 number of positions, then the positions.
+
+namespace Tablebase {
+// what the index and the file format cover. generating a 5-man table takes a lot of time
+// and memory, 3 and 4 men are quick.
+constexpr int MAX_MEN = 5;
+
+constexpr uint8_t DRAW = 0;
+// only while generating, for a position not worked out yet
+constexpr uint8_t UNKNOWN = 255;
+
+constexpr auto is_win(uint8_t code) -> bool { return code & 1; }
+constexpr auto is_loss(uint8_t code) -> bool { return code != DRAW && code != UNKNOWN && !(code & 1); }
+// plies to mate, for a win or a loss
+constexpr auto distance(uint8_t code) -> int { return is_win(code) ? code : code - 2; }
+constexpr auto win_in(int plies) -> uint8_t { return (uint8_t)plies; }
+constexpr auto loss_in(int plies) -> uint8_t { return (uint8_t)(plies + 2); }
+// the longest distance to mate a code can hold, what's left below UNKNOWN
+constexpr int MAX_DISTANCE = 253;
+
+// counts of each piece type per colour, without the kings
+struct Signature {
+    int counts[2][6] = {};
+
+    auto men() const -> int {
+        int total = 2;
+        for (const auto& side : counts) {
+            for (int piece = PAWN; piece < KING; piece++) total += side[piece];
+        }
+        return total;
+    }
+
+    auto has_pawns() const -> bool {
+        return counts[WHITE][PAWN] || counts[BLACK][PAWN];
+    }
+
+    // 4 bits per count, enough to tell every signature the tables cover apart
+    auto id() const -> U64 {
+        U64 key = 0;
+        for (Colour colour : {WHITE, BLACK}) {
+            for (int piece = PAWN; piece < KING; piece++) key = (key << 4) | counts[colour][piece];
+        }
+        return key;
+    }
+
+    auto side_name(Colour colour) const -> std::string {
+        std::string name = "K";
+        for (int piece = QUEEN; piece >= PAWN; piece--) name += std::string(counts[colour][piece], "PNBRQK"[piece]);
+        return name;
+    }
+
+    auto name() const -> std::string {
+        return side_name(WHITE) + "v" + side_name(BLACK);
+    }
+
+    auto strength(Colour colour) const -> int {
+        constexpr int VALUE[5] = {1, 3, 3, 5, 9};
+        int total = 0;
+        for (int piece = PAWN; piece < KING; piece++) total += VALUE[piece] * counts[colour][piece];
+        return total;
+    }
+
+    // tables are kept with the stronger side as white, this says whether to swap colours
+    // (more material, then more of the bigger pieces)
+    auto needs_flip() const -> bool {
+        int white = strength(WHITE), black = strength(BLACK);
+        if (white != black) return black > white;
+        for (int piece = QUEEN; piece >= PAWN; piece--) {
+            if (counts[WHITE][piece] != counts[BLACK][piece]) return counts[BLACK][piece] > counts[WHITE][piece];
+        }
+        return false;
+    }
+
+    auto flipped() const -> Signature {
+        Signature other;
+        for (int piece = PAWN; piece < KING; piece++) {
+            other.counts[WHITE][piece] = counts[BLACK][piece];
+            other.counts[BLACK][piece] = counts[WHITE][piece];
+        }
+        return other;
+    }
+
+    auto canonical() const -> Signature {
+        return needs_flip() ? flipped() : *this;
+    }
+};
+
+auto signature_of(const State& state) -> Signature {
+    Signature signature;
+    for (Colour colour : {WHITE, BLACK}) {
+        for (int piece = PAWN; piece < KING; piece++) {
+            signature.counts[colour][piece] = popcount(state.pieces[piece] & state.occupied_co[colour]);
+        }
+    }
+    return signature;
+}
+
+// "KQvKR" -> signature, false if it isn't one
+auto parse_signature(const std::string& name, Signature& signature) -> bool {
+    signature = Signature();
+    size_t split = name.find('v');
+    if (split == std::string::npos || name.size() < 3 || name[0] != 'K' || name[split + 1] != 'K') return false;
+    for (size_t i = 1; i < name.size(); i++) {
+        if (i == split || i == split + 1) continue;
+        const char* letter = std::strchr("PNBRQ", name[i]);
+        if (!letter || !name[i]) return false;
+        signature.counts[i < split ? WHITE : BLACK][letter - "PNBRQ"]++;
+    }
+    return signature.men() <= MAX_MEN;
+}
+
+////////////////////////////////// INDEXING //////////////////////////////////
+
+// the squares the stronger king is folded onto: the a1-d1-d4 triangle without pawns
+constexpr int TRIANGLE[10] = {A1, B1, C1, D1, B2, C2, D2, C3, D3, D4};
+
+struct KingSlots {
+    int slot[64];
+
+    constexpr KingSlots() : slot{} {
+        for (int& s : slot) s = -1;
+        for (int i = 0; i < 10; i++) slot[TRIANGLE[i]] = i;
+    }
+};
+
+constexpr KingSlots KING_SLOTS = KingSlots();
+
+// which reflections bring the stronger king into its corner, as a bit set:
+// 1 mirrors the files, 2 mirrors the ranks, 4 flips along the a1-h8 diagonal
+constexpr auto symmetry(int king, bool pawns) -> int {
+    int flags = 0;
+    if (king % 8 > 3) {
+        flags |= 1;
+        king ^= 7;
+    }
+    if (pawns) return flags;
+    if (king / 8 > 3) {
+        flags |= 2;
+        king ^= 56;
+    }
+    if (king / 8 > king % 8) flags |= 4;
+    return flags;
+}
+
+constexpr auto transform(int square, int flags) -> int {
+    if (flags & 1) square ^= 7;
+    if (flags & 2) square ^= 56;
+    if (flags & 4) square = (square % 8) * 8 + square / 8;
+    return square;
+}
+
+// the men of a signature in the order the index lists them: white king, white pieces from
+// the queen down, black king, black pieces
+struct Layout {
+    int men = 0;
+    Colour colours[MAX_MEN];
+    Piece pieces[MAX_MEN];
+    bool pawns = false;
+    U64 size = 0;
+
+    Layout() = default;
+
+    Layout(const Signature& signature) {
+        pawns = signature.has_pawns();
+        for (Colour colour : {WHITE, BLACK}) {
+            colours[men] = colour;
+            pieces[men++] = KING;
+            for (int piece = QUEEN; piece >= PAWN; piece--) {
+                for (int i = 0; i < signature.counts[colour][piece]; i++) {
+                    colours[men] = colour;
+                    pieces[men++] = (Piece)piece;
+                }
+            }
+        }
+        size = 2 * king_slots();
+        for (int i = 1; i < men; i++) size *= 64;
+    }
+
+    auto king_slots() const -> U64 {
+        return pawns ? 32 : 10;
+    }
+
+    // the index of a position with this layout, flipping the colours first if flip is set
+    auto index(const State& state, bool flip) const -> U64 {
+        int squares[MAX_MEN];
+        int n = 0;
+        for (Colour colour : {WHITE, BLACK}) {
+            U64 side = state.occupied_co[flip ? !colour : colour];
+            for (U64 bb = side & state.pieces[KING]; bb; bb &= bb - 1) squares[n++] = bitscan_forward(bb) ^ (flip ? 56 : 0);
+            for (int piece = QUEEN; piece >= PAWN; piece--) {
+                for (U64 bb = side & state.pieces[piece]; bb; bb &= bb - 1) squares[n++] = bitscan_forward(bb) ^ (flip ? 56 : 0);
+            }
+        }
+        Colour turn = flip ? !state.turn : state.turn;
+        int flags = symmetry(squares[0], pawns);
+        int king = transform(squares[0], flags);
+        auto index_with = [&](int f) {
+            U64 index = (U64)turn * king_slots() + (U64)(pawns ? (king / 8) * 4 + king % 8 : KING_SLOTS.slot[king]);
+            for (int i = 1; i < men; i++) index = index * 64 + transform(squares[i], f);
+            return index;
+        };
+        // a king on the diagonal stays put when the board is flipped along it, so the
+        // position can be written two ways. taking the smaller keeps the index unique.
+        if (!pawns && king / 8 == king % 8) return std::min(index_with(flags), index_with(flags ^ 4));
+        return index_with(flags);
+    }
+
+    // the other way round: sets the squares and side to move for an index
+    void squares_of(U64 index, int squares[MAX_MEN], Colour& turn) const {
+        for (int i = men - 1; i >= 1; i--) {
+            squares[i] = (int)(index % 64);
+            index /= 64;
+        }
+        int slot = (int)(index % king_slots());
+        squares[0] = pawns ? (slot / 4) * 8 + slot % 4 : TRIANGLE[slot];
+        turn = (Colour)(index / king_slots());
+    }
+};
+
+/////////////////////////////////// TABLES ///////////////////////////////////
+
+struct Table {
+    Signature signature;
+    Layout layout;
+    std::string path;
+    std::once_flag mapped;
+    MappedFile file;
+    // points into the mapping, or at the positions being generated
+    const uint8_t* positions = nullptr;
+    int longest_mate = 0;
+};
+
+class Tablebases {
+    std::unordered_map<U64, std::unique_ptr<Table>> tables;
+    int largest = 0;
+
+    // maps a table's file the first time it's needed. call_once makes the first thread to
+    // get here do it while any other waits, after that it's a plain read.
+    auto positions_of(Table& table) const -> const uint8_t* {
+        std::call_once(table.mapped, [&table] {
+            if (table.positions || !table.file.open(table.path)) return;
+            const unsigned char* data = table.file.data();
+            U64 count = 0;
+            // the 16 byte header has to be there before any of it is read
+            bool valid = table.file.size() >= 16 && std::memcmp(data, "VTB1", 4) == 0;
+            if (valid) std::memcpy(&count, data + 8, sizeof(count));
+            if (!valid || count > table.file.size() - 16 || count != table.layout.size) {
+                std::cerr << "bad tablebase file " << table.path << "\n";
+                table.file.close();
+                return;
+            }
+            table.longest_mate = data[5];
+            table.positions = data + 16;
+        });
+        return table.positions;
+    }
+
+   public:
+    // set while generating, so lookups in the table being made go to the unfinished positions
+    const Table* generating = nullptr;
+
+    static auto file_name(const std::string& directory, const Signature& signature) -> std::string {
+        return directory + "/" + signature.name() + ".vtb";
+    }
+
+    // the most men of any table found
+    auto max_men() const -> int {
+        return largest;
+    }
+
+    auto find(const Signature& signature) -> Table* {
+        auto it = tables.find(signature.id());
+        return it == tables.end() ? nullptr : it->second.get();
+    }
+
+    auto add(const Signature& signature, const std::string& path) -> Table* {
+        auto table = std::make_unique<Table>();
+        table->signature = signature;
+        table->layout = Layout(signature);
+        table->path = path;
+        Table* added = table.get();
+        tables[signature.id()] = std::move(table);
+        largest = std::max(largest, signature.men());
+        return added;
+    }
+
+    // looks in a directory for every table up to MAX_MEN. nothing is read yet, the files
+    // are only mapped when a probe first needs them. returns how many were found.
+    auto init(const std::string& directory) -> int {
+        tables.clear();
+        largest = 0;
+        int found = 0;
+        // every split of up to MAX_MEN - 2 pieces between the two sides
+        std::vector<Signature> pending = {Signature()};
+        for (size_t i = 0; i < pending.size(); i++) {
+            Signature signature = pending[i];
+            if (signature.men() >= MAX_MEN) continue;
+            for (Colour colour : {WHITE, BLACK}) {
+                for (int piece = PAWN; piece < KING; piece++) {
+                    Signature more = signature;
+                    more.counts[colour][piece]++;
+                    if (more.canonical().id() != more.id()) continue;
+                    if (std::find_if(pending.begin(), pending.end(), [&](const Signature& s) { return s.id() == more.id(); }) != pending.end()) continue;
+                    pending.push_back(more);
+                }
+            }
+        }
+        for (const Signature& signature : pending) {
+            if (signature.men() < 3) continue;
+            std::string path = file_name(directory, signature);
+            if (std::FILE* f = std::fopen(path.c_str(), "rb")) {
+                std::fclose(f);
+                add(signature, path);
+                found++;
+            }
+        }
+        return found;
+    }
+
+    // the code for a position from the side to move's point of view, with nothing to do with
+    // en passant or castling. false if there's no table for it.
+    auto probe_code(const State& state, uint8_t& code) -> bool {
+        Signature signature = signature_of(state);
+        if (signature.men() == 2) {
+            code = DRAW;
+            return true;
+        }
+        bool flip = signature.needs_flip();
+        Table* table = find(flip ? signature.flipped() : signature);
+        if (!table) return false;
+        const uint8_t* positions = table == generating ? table->positions : positions_of(*table);
+        if (!positions) return false;
+        code = positions[table->layout.index(state, flip)];
+        return true;
+    }
+
+    // like probe_code, but an en-passant capture is looked at by trying the moves
+    auto probe(State& state, uint8_t& code) -> bool {
+        if (state.castling_rights || popcount(state.occupied) > std::max(largest, 2)) return false;
+        if (!state.ep_square) return probe_code(state, code);
+        return combine(state, code);
+    }
+
+    // a position's code from its children's: a win if any child is lost (the quickest one),
+    // lost if every child is won (the slowest one), unknown while any child is, else a draw
+    auto combine(State& state, uint8_t& code) -> bool {
+        MoveList moves = state.legal_moves();
+        if (moves.empty()) {
+            code = state.is_check() ? loss_in(0) : DRAW;
+            return true;
+        }
+        int quickest_win = INT_MAX;
+        int slowest_loss = 0;
+        bool all_won = true;
+        bool unknown = false;
+        for (Move move : moves) {
+            state.push(move);
+            uint8_t child;
+            bool found = probe(state, child);
+            state.pop(move);
+            if (!found) return false;
+            if (child == UNKNOWN) {
+                unknown = true;
+                all_won = false;
+            } else if (is_loss(child)) {
+                quickest_win = std::min(quickest_win, distance(child) + 1);
+                all_won = false;
+            } else if (is_win(child)) {
+                slowest_loss = std::max(slowest_loss, distance(child) + 1);
+            } else {
+                all_won = false;
+            }
+        }
+        if (quickest_win != INT_MAX) {
+            code = win_in(quickest_win);
+        } else if (all_won) {
+            code = loss_in(slowest_loss);
+        } else {
+            code = unknown ? UNKNOWN : DRAW;
+        }
+        return true;
+    }
+};
+
+// shared by every search thread
+Tablebases TABLEBASES;
+
+///////////////////////////////// GENERATION /////////////////////////////////
+
+// puts the men of a layout on an empty board, nothing else about the position is kept
+void set_up(State& state, const Layout& layout, const int squares[MAX_MEN], Colour turn) {
+    state.occupied = 0;
+    state.occupied_co[WHITE] = state.occupied_co[BLACK] = 0;
+    for (U64& bb : state.pieces) bb = 0;
+    for (int i = 0; i < layout.men; i++) {
+        U64 bb = 1ULL << squares[i];
+        state.occupied |= bb;
+        state.occupied_co[layout.colours[i]] |= bb;
+        state.pieces[layout.pieces[i]] |= bb;
+    }
+    state.turn = turn;
+    state.promoted = state.ep_square = state.castling_rights = 0;
+    state.halfmove_clock = state.history_len = 0;
+    state.key = state.pawn_key = 0;
+    state.psqt = state.phase = 0;
+}
+
+// two men on a square, a pawn on the back rank, the kings touching or the side not to move in check
+auto is_valid(State& state, const Layout& layout) -> bool {
+    if (popcount(state.occupied) != layout.men) return false;
+    if (state.pieces[PAWN] & (BB_RANK_1 | BB_RANK_8)) return false;
+    U64 white_king = state.pieces[KING] & state.occupied_co[WHITE];
+    if (BB_KING_ATTACKS[bitscan_forward(white_king)] & state.pieces[KING] & ~white_king) return false;
+    state.turn = !state.turn;
+    bool capturable_king = state.is_check();
+    state.turn = !state.turn;
+    return !capturable_king;
+}
+
+// the tables a capture or a promotion out of this one leads to
+auto successors(const Signature& signature) -> std::vector<Signature> {
+    std::vector<Signature> next;
+    for (Colour colour : {WHITE, BLACK}) {
+        for (int piece = PAWN; piece < KING; piece++) {
+            if (!signature.counts[colour][piece]) continue;
+            Signature captured = signature;
+            captured.counts[colour][piece]--;
+            next.push_back(captured);
+            if (piece != PAWN) continue;
+            for (int promotion = KNIGHT; promotion <= QUEEN; promotion++) {
+                Signature promoted = signature;
+                promoted.counts[colour][PAWN]--;
+                promoted.counts[colour][promotion]++;
+                next.push_back(promoted);
+                // promoting with a capture
+                for (int victim = KNIGHT; victim < KING; victim++) {
+                    if (!promoted.counts[!colour][victim]) continue;
+                    Signature both = promoted;
+                    both.counts[!colour][victim]--;
+                    next.push_back(both);
+                }
+            }
+        }
+    }
+    for (Signature& s : next) s = s.canonical();
+    return next;
+}
+
+// calls parent() with the state set up as each position the side that just moved could
+// have come from without a capture or a promotion, i.e. the positions one move back in
+// the same table. only_double_pushes keeps to the pawn double steps.
+template <typename F>
+void for_each_parent(State& state, const Layout& layout, bool only_double_pushes, F parent) {
+    const Colour mover = !state.turn;
+    const U64 empty = ~state.occupied;
+    auto try_from = [&](Square to, Square from, Piece piece) {
+        U64 from_to = (1ULL << from) | (1ULL << to);
+        state.occupied ^= from_to;
+        state.occupied_co[mover] ^= from_to;
+        state.pieces[piece] ^= from_to;
+        state.turn = mover;
+        // the side that didn't move can't be left in check
+        if (is_valid(state, layout)) parent();
+        state.turn = !mover;
+        state.occupied ^= from_to;
+        state.occupied_co[mover] ^= from_to;
+        state.pieces[piece] ^= from_to;
+    };
+    for (int piece = PAWN; piece <= KING; piece++) {
+        if (only_double_pushes && piece != PAWN) break;
+        for (U64 bb = state.pieces[piece] & state.occupied_co[mover]; bb; bb &= bb - 1) {
+            Square to = bitscan_forward(bb);
+            U64 froms;
+            if (piece == PAWN) {
+                Square one = (Square)(to - PAWN_STEP[mover]);
+                Square two = (Square)(one - PAWN_STEP[mover]);
+                froms = 0;
+                if ((empty & (1ULL << one)) && !(BB_HOME_RANK[mover] & (1ULL << one)) && !only_double_pushes) froms |= 1ULL << one;
+                if ((BB_DOUBLE_PUSH_RANK[mover] & (1ULL << two)) && (empty & (1ULL << one)) && (empty & (1ULL << two))) froms |= 1ULL << two;
+            } else if (piece == KNIGHT) {
+                froms = BB_KNIGHT_ATTACKS[to] & empty;
+            } else if (piece == BISHOP) {
+                froms = get_bishop_moves(to, state.occupied) & empty;
+            } else if (piece == ROOK) {
+                froms = get_rook_moves(to, state.occupied) & empty;
+            } else if (piece == QUEEN) {
+                froms = get_queen_moves(to, state.occupied) & empty;
+            } else {
+                froms = BB_KING_ATTACKS[to] & empty;
+            }
+            for (; froms; froms &= froms - 1) try_from(to, bitscan_forward(froms), (Piece)piece);
+        }
+    }
+}
+
+// works out one table by retrograde analysis and writes it to the directory, generating
+// any table it depends on first.
+//
+// pass n settles exactly the positions that mate or are mated in n plies, so every distance
+// found is the shortest. a pass only looks at the positions one move before something the
+// last pass settled, found by un-making moves, and at positions an earlier look found a
+// result for that is due in this pass (a mate through a capture into a smaller table, say).
+// what's left when nothing is due any more is drawn.
+auto generate(const std::string& directory, Signature signature, bool verbose = true) -> bool {
+    signature = signature.canonical();
+    if (signature.men() < 3 || signature.men() > MAX_MEN) return signature.men() < 3;
+    if (TABLEBASES.find(signature)) return true;
+    for (const Signature& next : successors(signature)) {
+        if (next.men() >= 3 && !TABLEBASES.find(next)) {
+            std::string path = Tablebases::file_name(directory, next);
+            if (std::FILE* f = std::fopen(path.c_str(), "rb")) {
+                std::fclose(f);
+                TABLEBASES.add(next, path);
+            } else if (!generate(directory, next, verbose)) {
+                return false;
+            }
+        }
+    }
+
+    Layout layout(signature);
+    std::vector<uint8_t> positions(layout.size, UNKNOWN);
+    Table* table = TABLEBASES.add(signature, Tablebases::file_name(directory, signature));
+    table->positions = positions.data();
+    TABLEBASES.generating = table;
+
+    State state;
+    int squares[MAX_MEN];
+    Colour turn;
+    std::vector<U64> visit;
+    // pass 0: mates and stalemates, and what can't happen. some positions have more than one
+    // index (two men of a kind in either order, a king on the diagonal), only the one index()
+    // gives is worked out here and the others are copied from it at the end.
+    for (U64 index = 0; index < layout.size; index++) {
+        layout.squares_of(index, squares, turn);
+        set_up(state, layout, squares, turn);
+        if (!is_valid(state, layout) || layout.index(state, false) != index) {
+            positions[index] = DRAW;
+        } else if (state.num_legal_moves() == 0) {
+            positions[index] = state.is_check() ? loss_in(0) : DRAW;
+        } else {
+            visit.push_back(index);
+        }
+    }
+
+    std::vector<std::vector<U64>> due(MAX_DISTANCE + 1);
+    std::vector<U64> settled;
+    int longest_mate = 0;
+    for (int pass = 1;; pass++) {
+        if (pass > MAX_DISTANCE) {
+            std::cerr << signature.name() << ": mate too long to store\n";
+            TABLEBASES.generating = nullptr;
+            return false;
+        }
+        visit.insert(visit.end(), due[pass].begin(), due[pass].end());
+        due[pass].clear();
+        std::sort(visit.begin(), visit.end());
+        visit.erase(std::unique(visit.begin(), visit.end()), visit.end());
+
+        settled.clear();
+        for (U64 index : visit) {
+            if (positions[index] != UNKNOWN) continue;
+            layout.squares_of(index, squares, turn);
+            set_up(state, layout, squares, turn);
+            uint8_t code;
+            TABLEBASES.combine(state, code);
+            if (code == DRAW) {
+                positions[index] = DRAW;
+            } else if (code != UNKNOWN && distance(code) <= pass) {
+                positions[index] = code;
+                settled.push_back(index);
+                longest_mate = std::max(longest_mate, distance(code));
+            } else if (code != UNKNOWN && distance(code) <= MAX_DISTANCE) {
+                due[distance(code)].push_back(index);
+            }
+        }
+
+        // the next pass looks at whatever could have moved into the positions just settled,
+        // and at whatever could have double pushed into those, since an en-passant position
+        // is worked out from its own children
+        visit.clear();
+        for (U64 index : settled) {
+            layout.squares_of(index, squares, turn);
+            set_up(state, layout, squares, turn);
+            for_each_parent(state, layout, false, [&] {
+                visit.push_back(layout.index(state, false));
+                for_each_parent(state, layout, true, [&] { visit.push_back(layout.index(state, false)); });
+            });
+        }
+        if (visit.empty() && std::all_of(due.begin() + pass + 1, due.end(), [](const std::vector<U64>& d) { return d.empty(); })) break;
+    }
+    for (U64 index = 0; index < layout.size; index++) {
+        if (positions[index] == UNKNOWN) positions[index] = DRAW;
+    }
+    // the other ways of writing the same position
+    for (U64 index = 0; index < layout.size; index++) {
+        layout.squares_of(index, squares, turn);
+        set_up(state, layout, squares, turn);
+        if (!is_valid(state, layout)) continue;
+        U64 written = layout.index(state, false);
+        if (written != index) positions[index] = positions[written];
+    }
+    TABLEBASES.generating = nullptr;
+
+    std::ofstream file(table->path, std::ios::binary);
+    char header[16] = {'V', 'T', 'B', '1', (char)layout.men, (char)longest_mate, 0, 0};
+    U64 count = layout.size;
+    std::memcpy(header + 8, &count, sizeof(count));
+    file.write(header, sizeof(header));
+    file.write((const char*)positions.data(), (std::streamsize)positions.size());
+    file.close();
+    if (!file) return false;
+    // from now on probes read the file like any other table
+    table->positions = nullptr;
+    table->longest_mate = longest_mate;
+    if (verbose) std::cout << signature.name() << ": " << layout.size << " positions, longest mate " << longest_mate << " plies\n";
+    return true;
+}
+};  // namespace Tablebase
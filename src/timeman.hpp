@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+#include "move.hpp"
+
+// how long to think about a move.
+//
+// from the clock, the increment and the number of moves to the next time control comes
+// a soft limit, the time a move should take on average, and a hard limit that the search is
+// never allowed past. the search polls the hard limit as it goes (every CLOCK_CHECK_INTERVAL
+// nodes); the soft one is only looked at between iterations, to decide whether another is
+// worth starting. how much of the soft limit to use depends on how the search is going:
+// a best move that keeps changing or a score that has just dropped buys more time, a best
+// move that has stood for several iterations lets the move go early.
+//
+// the move overhead is what gets lost between deciding on a move and the opponent's clock
+// starting (the GUI, the network), and is taken off before anything is shared out.
+
+struct TimeControl {
+    long long time = -1;  // ms left on our clock, -1 for none
+    long long increment = 0;
+    int moves_to_go = 0;       // 0 for the rest of the game
+    long long movetime = -1;  // ms for this move exactly, -1 for none
+};
+
+class TimeManager {
+    // plan as if the rest of the game (or a control this long) were this many moves
+    static constexpr int DEFAULT_MOVES_TO_GO = 40;
+    static constexpr int MAX_MOVES_TO_GO = 50;
+    // a move never takes more than this many soft limits, nor more than this share of the clock
+    static constexpr int HARD_TO_SOFT = 5;
+    static constexpr double MAX_CLOCK_SHARE = 0.75;
+
+    // soft limit scale by how many iterations in a row have kept the best move
+    static constexpr double STABILITY_SCALE[] = {2.2, 1.6, 1.3, 1.1, 0.9, 0.8, 0.7};
+    static constexpr int MAX_STABILITY = sizeof(STABILITY_SCALE) / sizeof(STABILITY_SCALE[0]) - 1;
+
+    // nanoseconds on the steady clock when the clock started running for us, atomic because
+    // ponderhit restarts it from the input thread while the search reads it
+    std::atomic<long long> start_ns{0};
+    long long soft = 0;  // ms, 0 for no limit
+    long long hard = 0;
+    bool adjustable = false;  // movetime and node or depth limits aren't stretched
+
+    Move last_best = NULL_MOVE;
+    int stability = 0;
+    int last_score = 0;
+    double scale = 1.0;
+
+    static auto now_ns() -> long long {
+        return (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+   public:
+    // sets the limits for a search starting now
+    void start(const TimeControl& control, int move_overhead) {
+        restart();
+        last_best = NULL_MOVE;
+        stability = 0;
+        last_score = 0;
+        scale = 1.0;
+        soft = hard = 0;
+        adjustable = false;
+        if (control.movetime >= 0) {
+            soft = hard = std::max(1LL, control.movetime - move_overhead);
+        } else if (control.time >= 0) {
+            int moves = control.moves_to_go > 0 ? std::min(control.moves_to_go, MAX_MOVES_TO_GO) : DEFAULT_MOVES_TO_GO;
+            // the time for the next `moves` moves, counting the increments they'll bring and the overhead each loses
+            long long left = control.time + control.increment * (moves - 1) - (long long)move_overhead * moves;
+            left = std::max(1LL, left);
+            long long cap = std::max(1LL, (long long)((control.time - move_overhead) * MAX_CLOCK_SHARE));
+            hard = std::min(left / moves * HARD_TO_SOFT, cap);
+            soft = std::min(std::max(1LL, left / moves), hard);
+            hard = std::max(1LL, hard);
+            adjustable = true;
+        }
+    }
+
+    // the clock starts again from now, as it does on a ponderhit
+    void restart() {
+        start_ns.store(now_ns(), std::memory_order_relaxed);
+    }
+
+    auto is_limited() const -> bool {
+        return hard > 0;
+    }
+
+    auto elapsed_ms() const -> long long {
+        return (now_ns() - start_ns.load(std::memory_order_relaxed)) / 1000000;
+    }
+
+    // polled during the search
+    auto out_of_time() const -> bool {
+        return hard > 0 && elapsed_ms() >= hard;
+    }
+
+    // called after every iteration the main thread finishes with its best move and score
+    void update(Move best_move, int score, int depth) {
+        if (!adjustable) return;
+        stability = best_move == last_best ? std::min(stability + 1, MAX_STABILITY) : 0;
+        double score_scale = 1.0;
+        // a score drop from one iteration to the next means the move we had is in trouble
+        if (depth > 1 && score < last_score) score_scale += std::min(last_score - score, 60) / 100.0;
+        scale = STABILITY_SCALE[stability] * score_scale;
+        last_best = best_move;
+        last_score = score;
+    }
+
+    // whether to leave the move at the iteration just finished. the next iteration takes
+    // longer than all the previous ones together, so one that can't finish in the time
+    // the soft limit leaves isn't started.
+    auto should_stop() const -> bool {
+        if (soft == 0) return false;
+        double target = std::min((double)hard, soft * scale);
+        return elapsed_ms() * 2 >= target;
+    }
+};
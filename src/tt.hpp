@@ -0,0 +1,252 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+#include "move.hpp"
+#include "names.hpp"
+
+using U64 = unsigned long long;
+
+// the transposition table, shared between every search thread.
+//
+// each bucket is one 64-byte cache line of four entries, and an entry is two 64-bit words:
+// the packed data and the key XORed with that data. the words are written and read
+// independently without any lock, so a reader can see half of one write and half of another,
+// but then the XOR no longer gives back the key and the entry just looks like a miss
+// (the "lockless hashing" scheme from Hyatt and Mann).
+//
+// data layout, low bits first:
+//   16 bits  move (Move::as_short)
+//   16 bits  score
+//   16 bits  static evaluation
+//    8 bits  depth
+//    2 bits  bound
+//    6 bits  age (the search generation that wrote it)
+
+enum Bound : uint8_t {
+    BOUND_NONE,
+    BOUND_UPPER,  // failed low, score is at most this
+    BOUND_LOWER,  // failed high, score is at least this
+    BOUND_EXACT
+};
+
+// what a probe hands back
+struct TTData {
+    Move move;
+    int score;
+    int eval;
+    int depth;
+    Bound bound;
+};
+
+class TranspositionTable {
+    static constexpr int BUCKET_SIZE = 4;
+    static constexpr int AGE_BITS = 6;
+    static constexpr int AGE_MASK = (1 << AGE_BITS) - 1;
+
+    struct Entry {
+        std::atomic<U64> key_xor_data;
+        std::atomic<U64> data;
+    };
+
+    struct alignas(64) Bucket {
+        Entry entries[BUCKET_SIZE];
+    };
+
+    Bucket* buckets = nullptr;
+    U64 num_buckets = 0;
+    size_t allocated_bytes = 0;
+    bool huge_pages = false;
+    uint8_t age = 0;
+
+    static auto pack(Move move, int score, int eval, int depth, Bound bound, uint8_t age) -> U64 {
+        return (U64)move.as_short() |
+               ((U64)(uint16_t)(int16_t)score << 16) |
+               ((U64)(uint16_t)(int16_t)eval << 32) |
+               ((U64)(uint8_t)depth << 48) |
+               ((U64)(bound | (age << 2)) << 56);
+    }
+
+    static auto data_move(U64 data) -> Move {
+        return Move((Square)((data >> 6) & 0x3f), (Square)(data & 0x3f), (data >> 12) & 0xf);
+    }
+    static auto data_score(U64 data) -> int { return (int16_t)(data >> 16); }
+    static auto data_eval(U64 data) -> int { return (int16_t)(data >> 32); }
+    static auto data_depth(U64 data) -> int { return (uint8_t)(data >> 48); }
+    static auto data_bound(U64 data) -> Bound { return (Bound)((data >> 56) & 0b11); }
+    static auto data_age(U64 data) -> uint8_t { return (data >> 58) & AGE_MASK; }
+
+    // maps a key onto a bucket with a multiply instead of a modulo, so any size works
+    auto bucket_for(U64 key) const -> Bucket* {
+#if defined(__SIZEOF_INT128__)
+        return &buckets[(U64)(((unsigned __int128)key * num_buckets) >> 64)];
+#else
+        return &buckets[key % num_buckets];
+#endif
+    }
+
+    void release() {
+        if (!buckets) return;
+#if defined(_WIN32)
+        _aligned_free(buckets);
+#else
+        std::free(buckets);
+#endif
+        buckets = nullptr;
+        num_buckets = 0;
+        allocated_bytes = 0;
+    }
+
+    auto allocate(size_t bytes) -> bool {
+        size_t alignment = alignof(Bucket);
+        huge_pages = false;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        constexpr size_t HUGE_PAGE = 2 * 1024 * 1024;
+        if (bytes >= HUGE_PAGE) {
+            alignment = HUGE_PAGE;
+            bytes -= bytes % HUGE_PAGE;
+        }
+#endif
+        bytes -= bytes % sizeof(Bucket);
+#if defined(_WIN32)
+        buckets = (Bucket*)_aligned_malloc(bytes, alignment);
+#else
+        buckets = (Bucket*)std::aligned_alloc(alignment, bytes);
+#endif
+        if (!buckets) return false;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        if (alignment > alignof(Bucket)) {
+            huge_pages = madvise(buckets, bytes, MADV_HUGEPAGE) == 0;
+        }
+#endif
+        allocated_bytes = bytes;
+        num_buckets = bytes / sizeof(Bucket);
+        return true;
+    }
+
+   public:
+    TranspositionTable(size_t mb = 16) {
+        resize(mb);
+    }
+
+    ~TranspositionTable() {
+        release();
+    }
+
+    TranspositionTable(const TranspositionTable&) = delete;
+    auto operator=(const TranspositionTable&) -> TranspositionTable& = delete;
+
+    // reallocates the table to (at most) mb mebibytes and clears it.
+    // on linux a table of 2 MiB or more is 2 MiB-aligned and advised onto transparent huge pages,
+    // which takes most of the TLB misses out of probing a big table.
+    // if that much memory can't be had the size is halved until it can, and the size the table
+    // ended up with (in bytes) is returned, so the caller can tell the user.
+    auto resize(size_t mb) -> size_t {
+        release();
+        size_t bytes = mb * 1024 * 1024;
+        if (bytes < sizeof(Bucket)) bytes = sizeof(Bucket);
+        while (!allocate(bytes) && bytes > sizeof(Bucket)) bytes /= 2;
+        clear();
+        return allocated_bytes;
+    }
+
+    auto size_bytes() const -> size_t {
+        return allocated_bytes;
+    }
+
+    void clear() {
+        if (buckets) std::memset((void*)buckets, 0, allocated_bytes);
+        age = 0;
+    }
+
+    // called once per search, so entries from earlier searches lose out in replacement
+    void new_search() {
+        age = (age + 1) & AGE_MASK;
+    }
+
+    // pulls a key's bucket towards the cache ahead of the probe, e.g. just before push()
+    void prefetch(U64 key) const {
+#if defined(__GNUC__)
+        __builtin_prefetch(bucket_for(key));
+#endif
+    }
+
+    // fills "out" and returns true if the key is in the table
+    auto probe(U64 key, TTData& out) const -> bool {
+        Bucket* bucket = bucket_for(key);
+        for (Entry& entry : bucket->entries) {
+            U64 data = entry.data.load(std::memory_order_relaxed);
+            U64 check = entry.key_xor_data.load(std::memory_order_relaxed);
+            if ((check ^ data) == key && data) {
+                out.move = data_move(data);
+                out.score = data_score(data);
+                out.eval = data_eval(data);
+                out.depth = data_depth(data);
+                out.bound = data_bound(data);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // replaces the entry for the same key if there is one, otherwise the entry that is
+    // least valuable: shallowest, with each search generation of age costing 8 plies
+    void store(U64 key, Move move, int score, int eval, int depth, Bound bound) {
+        Bucket* bucket = bucket_for(key);
+        Entry* replace = &bucket->entries[0];
+        int worst = 1 << 30;
+        for (Entry& entry : bucket->entries) {
+            U64 data = entry.data.load(std::memory_order_relaxed);
+            U64 check = entry.key_xor_data.load(std::memory_order_relaxed);
+            if ((check ^ data) == key) {
+                // same position: keep the old move if this search didn't find one, and
+                // don't let a shallow non-exact result overwrite a much deeper one
+                if (move.is_null()) move = data_move(data);
+                if (bound != BOUND_EXACT && depth + 4 < data_depth(data) && data_age(data) == age) return;
+                replace = &entry;
+                break;
+            }
+            int relative_age = (AGE_MASK + 1 + age - data_age(data)) & AGE_MASK;
+            int value = data ? data_depth(data) - 8 * relative_age : -(1 << 20);
+            if (value < worst) {
+                worst = value;
+                replace = &entry;
+            }
+        }
+        U64 data = pack(move, score, eval, depth, bound, age);
+        replace->data.store(data, std::memory_order_relaxed);
+        replace->key_xor_data.store(key ^ data, std::memory_order_relaxed);
+    }
+
+    // permille of sampled entries written during the current search, for UCI "hashfull"
+    auto hashfull() const -> int {
+        int used = 0;
+        U64 sample = num_buckets < 250 ? num_buckets : 250;
+        for (U64 i = 0; i < sample; i++) {
+            for (Entry& entry : buckets[i].entries) {
+                U64 data = entry.data.load(std::memory_order_relaxed);
+                used += data && data_age(data) == age;
+            }
+        }
+        return sample ? (int)(used * 1000 / (sample * BUCKET_SIZE)) : 0;
+    }
+
+    auto size_mb() const -> size_t {
+        return allocated_bytes / (1024 * 1024);
+    }
+
+    auto uses_huge_pages() const -> bool {
+        return huge_pages;
+    }
+};
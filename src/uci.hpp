@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "engine.hpp"
+#include "nnue.hpp"
+#include "state.hpp"
+#include "tablebase.hpp"
+#include "timeman.hpp"
+#include "vorpal_helpers.hpp"
+
+// the UCI protocol on stdin and stdout, for GUIs and match runners.
+//
+// the search runs on a thread of its own so that the input loop keeps reading while it
+// thinks: stop sets the flag every search thread checks at every node, so a search ends
+// within a few microseconds of the command. an infinite or ponder search keeps its
+// bestmove back until stop (or, for ponder, ponderhit) even if it finishes early, as the
+// protocol asks.
+
+class Uci {
+    Vorpal engine;
+    State position;
+    std::thread search_thread;
+
+    std::mutex hold_mutex;
+    std::condition_variable hold_released;
+    bool holding = false;  // the bestmove waits while this is set
+    bool infinite = false;
+
+    static constexpr const char* STARTPOS_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+    // the legal move written as in UCI ("e2e4", "e7e8q"), NULL_MOVE if there's none
+    static auto parse_move(const State& state, const std::string& text) -> Move {
+        for (Move move : state.legal_moves()) {
+            if (move_notation(move) == text) return move;
+        }
+        return NULL_MOVE;
+    }
+
+    void release_hold() {
+        {
+            std::lock_guard<std::mutex> lock(hold_mutex);
+            holding = false;
+        }
+        hold_released.notify_all();
+    }
+
+    // stops any search and waits for its bestmove
+    void stop() {
+        engine.stopped.store(true);
+        release_hold();
+        if (search_thread.joinable()) search_thread.join();
+    }
+
+    // position [startpos | fen <fen>] [moves <move>...]
+    void set_position(std::istringstream& in) {
+        std::string token, fen;
+        in >> token;
+        if (token == "startpos") {
+            fen = STARTPOS_FEN;
+            in >> token;
+        } else if (token == "fen") {
+            while (in >> token && token != "moves") fen += token + " ";
+        } else {
+            return;
+        }
+        if (!position.load_fen(fen)) {
+            std::cout << "info string invalid position " << fen << std::endl;
+            return;
+        }
+        if (token != "moves") return;
+        while (in >> token) {
+            Move move = parse_move(position, token);
+            if (move.is_null()) break;
+            position.push(move);
+            // the search stacks up to MAX_PLY records of its own on the game's
+            if (position.history_len >= MAX_GAME_PLIES - 2 * MAX_PLY) position.trim_history();
+        }
+    }
+
+    // go [wtime <ms>] [btime <ms>] [winc <ms>] [binc <ms>] [movestogo <n>] [movetime <ms>]
+    //    [depth <n>] [nodes <n>] [infinite] [ponder]
+    void go(std::istringstream& in) {
+        stop();
+        long long time[2] = {-1, -1}, increment[2] = {0, 0};
+        long long movetime = -1, nodes = 0;
+        int depth = MAX_PLY - 1, moves_to_go = 0;
+        bool ponder = false;
+        infinite = false;
+        std::string token;
+        while (in >> token) {
+            if (token == "wtime") in >> time[WHITE];
+            else if (token == "btime") in >> time[BLACK];
+            else if (token == "winc") in >> increment[WHITE];
+            else if (token == "binc") in >> increment[BLACK];
+            else if (token == "movestogo") in >> moves_to_go;
+            else if (token == "movetime") in >> movetime;
+            else if (token == "depth") in >> depth;
+            else if (token == "nodes") in >> nodes;
+            else if (token == "infinite") infinite = true;
+            else if (token == "ponder") ponder = true;
+        }
+
+        TimeControl control;
+        if (!infinite) {
+            control.time = time[position.turn];
+            control.increment = increment[position.turn];
+            control.moves_to_go = moves_to_go;
+            control.movetime = movetime;
+        }
+        engine.set_time_control(control);
+        engine.set_node_limit((U64)nodes);
+
+        engine.stopped.store(false);
+        engine.pondering.store(ponder);
+        holding = infinite || ponder;
+        search_thread = std::thread([this, root = position, depth] {
+            SearchResult result = engine.search(root, depth, false);
+            {
+                std::unique_lock<std::mutex> lock(hold_mutex);
+                hold_released.wait(lock, [this] { return !holding; });
+            }
+            std::cout << "bestmove " << (result.best_move.is_null() ? "0000" : move_notation(result.best_move));
+            if (!result.ponder_move.is_null()) std::cout << " ponder " << move_notation(result.ponder_move);
+            std::cout << std::endl;
+        });
+    }
+
+    // the opponent played the move we were pondering on, so the clock is ours again
+    void ponderhit() {
+        engine.ponderhit();
+        if (!infinite) release_hold();
+    }
+
+    struct SpinOption {
+        const char* name;
+        int value, min, max;  // value is the default
+    };
+
+    static constexpr SpinOption SPIN_OPTIONS[] = {
+        {"Hash", 16, 1, 65536},
+        {"Threads", 1, 1, 256},
+        {"Contempt", 30, -200, 200},
+        {"Move Overhead", 10, 0, 5000},
+        {"TablebaseProbeLimit", Tablebase::MAX_MEN, 0, Tablebase::MAX_MEN},
+    };
+
+    static void print_options() {
+        for (const SpinOption& spin : SPIN_OPTIONS) {
+            std::cout << "option name " << spin.name << " type spin default " << spin.value << " min " << spin.min
+                      << " max " << spin.max << "\n";
+        }
+        std::cout << "option name Ponder type check default false\n"
+                  << "option name EvalFile type string default <empty>\n"
+                  << "option name BookFile type string default <empty>\n"
+                  << "option name TablebasePath type string default <empty>\n";
+    }
+
+    // a spin option's value from text, clamped to its range. false if the text isn't a number.
+    static auto parse_spin(const SpinOption& spin, const std::string& text, int& value) -> bool {
+        long long number = 0;
+        auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), number);
+        if (text.empty() || end != text.data() + text.size() || error == std::errc::invalid_argument) return false;
+        if (error == std::errc::result_out_of_range) number = text[0] == '-' ? spin.min : spin.max;
+        value = (int)std::clamp(number, (long long)spin.min, (long long)spin.max);
+        return true;
+    }
+
+    // setoption name <name> [value <value>]
+    void set_option(std::istringstream& in) {
+        std::string token, name, value;
+        in >> token;
+        while (in >> token && token != "value") name += (name.empty() ? "" : " ") + token;
+        while (in >> token) value += (value.empty() ? "" : " ") + token;
+        if (value == "<empty>") value.clear();
+
+        // a spin option given something that isn't a number is left as it was
+        int spin = 0;
+        for (const SpinOption& option : SPIN_OPTIONS) {
+            if (name == option.name && !parse_spin(option, value, spin)) {
+                std::cout << "info string invalid value " << value << " for " << name << std::endl;
+                return;
+            }
+        }
+
+        stop();
+        if (name == "Hash") {
+            size_t got = engine.set_hash_size((size_t)spin);
+            if (got < (size_t)spin) std::cout << "info string not enough memory for " << spin << " MB of hash, using " << got << " MB" << std::endl;
+        } else if (name == "Threads") {
+            engine.set_threads(spin);
+        } else if (name == "Contempt") {
+            engine.set_contempt(spin);
+        } else if (name == "Move Overhead") {
+            engine.set_move_overhead(spin);
+        } else if (name == "EvalFile") {
+            if (!value.empty() && !Nnue::load(value)) std::cout << "info string can't load network " << value << std::endl;
+            if (value.empty()) Nnue::ACTIVE = false;
+            position.refresh_accumulator();
+        } else if (name == "BookFile") {
+            engine.book.close();
+            if (!value.empty() && !engine.book.open(value)) std::cout << "info string can't open book " << value << std::endl;
+        } else if (name == "TablebasePath") {
+            int found = Tablebase::TABLEBASES.init(value);
+            std::cout << "info string found " << found << " tablebases" << std::endl;
+        } else if (name == "TablebaseProbeLimit") {
+            engine.set_tb_limit(spin);
+        }
+    }
+
+   public:
+    Uci() {
+        position.load_fen(STARTPOS_FEN);
+    }
+
+    ~Uci() {
+        stop();
+    }
+
+    // reads commands until quit or the end of the input
+    void loop(std::istream& input = std::cin) {
+        std::string line;
+        while (std::getline(input, line)) {
+            std::istringstream in(line);
+            std::string command;
+            in >> command;
+            if (command == "uci") {
+                std::cout << "id name Vorpal\nid author the Vorpal authors\n";
+                print_options();
+                std::cout << "uciok" << std::endl;
+            } else if (command == "isready") {
+                std::cout << "readyok" << std::endl;
+            } else if (command == "ucinewgame") {
+                stop();
+                engine.tt.clear();
+            } else if (command == "position") {
+                stop();
+                set_position(in);
+            } else if (command == "go") {
+                go(in);
+            } else if (command == "stop") {
+                stop();
+            } else if (command == "ponderhit") {
+                ponderhit();
+            } else if (command == "setoption") {
+                set_option(in);
+            } else if (command == "quit") {
+                break;
+            }
+        }
+        stop();
+    }
+};
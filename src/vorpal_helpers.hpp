@@ -1,23 +1,21 @@
+#pragma once
+
 #include <cassert>
+#include <cctype>
 #include <iostream>
 #include <string>
 #include <vector>
 
-#include "MaskSet.hpp"
-#include "engine.hpp"
-#include "intrinsic_functions.hpp"
 #include "move.hpp"
-#include "movegen.hpp"
 #include "names.hpp"
-#include "state.hpp"
 
 constexpr auto INF = 10000000000;
 
 using U64 = unsigned long long;
 
 auto square_notation(Square index) -> std::string {
-    // 0 => A8
-    // 63 => H1
+    // 0 => A1
+    // 63 => H8
     char letters[8] = {'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H'};
     char numbers[8] = {'1', '2', '3', '4', '5', '6', '7', '8'};
     char first;
@@ -32,9 +30,20 @@ auto square_notation(Square index) -> std::string {
 //FUNCTIONS AND OVERLOADS
 
 auto square_from_an(std::string an_square) -> int {
-    int a = 7 - (an_square[0] - 97);
-    int b = an_square[1] - '0' - 1;
-    return 63 - (a + 8 * b);
+    int file = std::tolower(an_square[0]) - 'a';
+    int rank = an_square[1] - '1';
+    return file + 8 * rank;
+}
+
+// the move in long algebraic notation, as UCI wants it (e2e4, e7e8q, e1g1)
+auto move_notation(Move move) -> std::string {
+    std::string builder;
+    for (char c : square_notation((Square)move.get_from())) builder.push_back((char)std::tolower(c));
+    for (char c : square_notation((Square)move.get_to())) builder.push_back((char)std::tolower(c));
+    if (move.is_promotion()) {
+        builder.push_back("nbrq"[move.get_flags() & 0b11]);
+    }
+    return builder;
 }
 
 template <class T>
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "names.hpp"
+
+using U64 = unsigned long long;
+
+// zobrist keys: a random 64-bit number for every (colour, piece, square), for each
+// combination of castling rights, for each en-passant file and for the side to move.
+// a position's key is the XOR of the numbers for everything in it, so a move updates
+// the key with a handful of XORs. the numbers are generated at compile time.
+
+namespace Zobrist {
+struct Keys {
+    U64 pieces[2][6][64];
+    U64 castling[16];
+    U64 ep_file[8];
+    U64 side;
+};
+
+// splitmix64, one step
+constexpr auto next_random(U64& state) -> U64 {
+    state += 0x9E3779B97F4A7C15ULL;
+    U64 z = state;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+constexpr auto generate() -> Keys {
+    Keys keys{};
+    U64 state = 0x766F7270616C3031ULL;
+    for (auto& colour : keys.pieces) {
+        for (auto& piece : colour) {
+            for (U64& square : piece) square = next_random(state);
+        }
+    }
+    for (U64& k : keys.castling) k = next_random(state);
+    for (U64& k : keys.ep_file) k = next_random(state);
+    keys.side = next_random(state);
+    return keys;
+}
+
+constexpr Keys KEYS = generate();
+
+// the castling rights are kept as a bitboard of rook squares, squash them into four bits
+constexpr auto castling_index(U64 castling_rights) -> int {
+    return (int)((castling_rights & 1) | ((castling_rights >> 6) & 2) | ((castling_rights >> 54) & 4) | ((castling_rights >> 60) & 8));
+}
+
+constexpr auto piece_key(Colour colour, Piece piece, int square) -> U64 {
+    return KEYS.pieces[colour][piece][square];
+}
+
+constexpr auto castling_key(U64 castling_rights) -> U64 {
+    return KEYS.castling[castling_index(castling_rights)];
+}
+
+// no en-passant square hashes as nothing at all
+constexpr auto ep_key(U64 ep_square) -> U64 {
+    return ep_square ? KEYS.ep_file[__builtin_ctzll(ep_square) % 8] : 0;
+}
+};  // namespace Zobrist